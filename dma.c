@@ -11,198 +11,409 @@
 #include <linux/errno.h>
 
 #include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/of.h>
+#include <linux/sizes.h>
 #include <linux/uaccess.h>
 
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
 
 #include "dma.h"
+#include "dma_aio.h"
+#include "dma_cyclic.h"
+#include "dma_stripe.h"
+#include "dma_poll.h"
+#include "dma_stat.h"
+#include "dma_trace.h"
 #include "log.h"
 #include "khack.h"
 
-/* buf must be within usr vma */
-static dma_addr_t _translate_buf(struct plng_dma_device * dma_dev,
-				 const void __user * buf,
-				 size_t bcount)
+static const struct vm_operations_struct dma_vm_ops = {
+};
+
+/* buf must be within one of ctx's IOBUF mappings */
+dma_addr_t dma_translate_buf(struct plng_dma_ctx *ctx,
+			     const void __user * buf,
+			     size_t bcount)
 {
-	struct vm_area_struct *vma = dma_dev->usr_vma;
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
 	size_t offset, cbuf = (size_t)buf;
-	dma_addr_t dbuf;
-	if (!vma)
-		return 0;
+	dma_addr_t dbuf = 0;
+
+	down_read(&mm->mmap_sem);
+	vma = find_vma(mm, cbuf);
+	if (!vma || cbuf < vma->vm_start)
+		goto SEM_UP;
+	if (vma->vm_ops != &dma_vm_ops || vma->vm_private_data != ctx)
+		goto SEM_UP;
+	if (bcount > vma->vm_end - cbuf)
+		goto SEM_UP;
+
+	offset = (vma->vm_pgoff << PAGE_SHIFT) + (cbuf - vma->vm_start);
+	if (offset >= ctx->buf_size || bcount > ctx->buf_size - offset)
+		goto SEM_UP;
+	dbuf = ctx->dma_buf + offset;
+
+SEM_UP:
+	up_read(&mm->mmap_sem);
+	return dbuf;
+}
 
-	if (cbuf < vma->vm_start || cbuf >= vma->vm_end) {
-		cbuf += bcount;
-		if (cbuf < vma->vm_start || cbuf >= vma->vm_end)
-			return 0;
+/**********************/
+/******** CHAN ********/
+/**********************/
+/*
+ * Slave config is per channel, so config, prep and submit of one
+ * transfer are done under chan_lock. Completion is waited for outside
+ * of it: transfers of several files queue up on the channel in lock
+ * order and each one waits on its own completion.
+ */
+int dma_chan_get(struct plng_dma_device *dma_dev)
+{
+	mutex_lock(&dma_dev->chan_lock);
+	/* running capture owns the channel */
+	if (dma_dev->cyclic_ctx) {
+		mutex_unlock(&dma_dev->chan_lock);
+		return -EBUSY;
 	}
+	return 0;
+}
 
-	offset = (size_t)buf - vma->vm_start;
-	dbuf = dma_dev->dma_base + offset;
+void dma_chan_put(struct plng_dma_device *dma_dev)
+{
+	mutex_unlock(&dma_dev->chan_lock);
+}
 
-	return dbuf;
+/* chan_lock held */
+dma_cookie_t dma_chan_submit(struct plng_dma_device *dma_dev,
+			     struct dma_async_tx_descriptor *desc)
+{
+	dma_cookie_t cookie = dmaengine_submit(desc);
+
+	if (dma_submit_error(cookie)) {
+		dev_err(&dma_dev->pdev->dev, "dma_submit() failure\n");
+		return cookie;
+	}
+
+	dma_dev->last_cookie = cookie;
+	dma_async_issue_pending(dma_dev->dmach);
+	return cookie;
+}
+
+/* chan_lock held, cookies complete in submit order */
+int dma_chan_idle(struct plng_dma_device *dma_dev)
+{
+	if (!dma_dev->last_cookie)
+		return 1;
+	return dmaengine_tx_status(dma_dev->dmach, dma_dev->last_cookie,
+				   NULL) != DMA_IN_PROGRESS;
+}
+
+/*
+ * chan_lock held on entry, dropped once desc is queued. Traced
+ * transfers up to poll_max bytes are polled for, see dma_poll_wait().
+ */
+int dma_submit_and_wait(struct plng_dma_device *dma_dev,
+			struct dma_async_tx_descriptor *desc,
+			struct dma_stat_ts *ts)
+{
+	bool poll = ts && dma_poll_want(dma_dev, ts->len);
+	struct dma_wait wait;
+	dma_cookie_t cookie;
+	u64 t, polled = 0;
+
+	/* polled waits too, they fall back to it past the deadline */
+	init_completion(&wait.done);
+	desc->callback = dma_dev->dma_callback;
+	desc->callback_param = &wait;
+	wait.ts = ts;
+	t = dma_stat_now(ts);
+	cookie = dma_chan_submit(dma_dev, desc);
+	dma_chan_put(dma_dev);
+
+	if (dma_submit_error(cookie))
+		return -EIO;
+	if (ts)
+		trace_dma_drv_issued(ts);
+
+	if (poll)
+		polled = dma_poll_wait(dma_dev, cookie, ts->len);
+	/* wait is on stack, callback must have run before return */
+	if (polled) {
+		/* cookie is retired just before the callback is invoked */
+		while (!completion_done(&wait.done))
+			cpu_relax();
+		wait.irq_ns = polled;
+	} else {
+		wait_for_completion(&wait.done);
+		atomic_long_inc(&dma_dev->irq_waits);
+	}
+	if (ts) {
+		trace_dma_drv_woken(ts);
+		ts->ns[DMA_STAT_HW] += wait.irq_ns - t;
+		dma_stat_add(ts, DMA_STAT_WAKE, wait.irq_ns);
+	}
+
+	if (dmaengine_tx_status(dma_dev->dmach, cookie, NULL) != DMA_COMPLETE)
+		return -EIO;
+	return 0;
 }
 
 /**********************/
-/******** READ ********/
+/***** COHERENCY ******/
 /**********************/
-ssize_t dma_read(struct plng_dma_device *dma_dev,
-		 void __user * dst,
-		 const loff_t br_offset,
-		 size_t count)
+static inline enum dma_data_direction
+dma_buf_map_dir(enum dma_transfer_direction dir)
+{
+	return dir == DMA_DEV_TO_MEM ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+}
+
+/* Hands IOBUF range over to the device, CACHED_IOBUF only */
+void dma_buf_sync_dev(struct plng_dma_ctx *ctx, dma_addr_t daddr,
+		      size_t len, enum dma_transfer_direction dir)
+{
+	if (ctx->coherency == CACHED_IOBUF)
+		dma_sync_single_for_device(ctx->dma_dev->dmach->device->dev,
+					   daddr, len, dma_buf_map_dir(dir));
+}
+
+/* Takes IOBUF range back once the device is done with it */
+void dma_buf_sync_cpu(struct plng_dma_ctx *ctx, dma_addr_t daddr,
+		      size_t len, enum dma_transfer_direction dir)
+{
+	if (ctx->coherency == CACHED_IOBUF)
+		dma_sync_single_for_cpu(ctx->dma_dev->dmach->device->dev,
+					daddr, len, dma_buf_map_dir(dir));
+}
+
+/* ACP only snoops cacheable requests, chan_lock held */
+void dma_buf_hack_cache(struct plng_dma_ctx *ctx,
+			struct dma_async_tx_descriptor *desc,
+			enum dma_transfer_direction dir)
+{
+	if (ctx->coherency == ACP_IOBUF)
+		dma_drv_hack_setcache(desc, dir, CCTRL7);
+}
+
+/* Stripe chains are built without ctx, so ACP IOBUFs are not striped */
+unsigned dma_buf_stripes(struct plng_dma_ctx *ctx, size_t count)
+{
+	if (ctx->coherency == ACP_IOBUF)
+		return 1;
+	return dma_stripe_count(ctx, count);
+}
+
+/* Single request between IOBUF and the bridge, not submitted yet,
+ * chan_lock held. fifo is INCR_ADDR or FIFO_ADDR for the bridge side */
+struct dma_async_tx_descriptor *
+dma_prep_iobuf(struct plng_dma_device *dma_dev,
+	       dma_addr_t daddr,
+	       loff_t br_offset,
+	       size_t count,
+	       enum dma_transfer_direction dir,
+	       unsigned long fifo,
+	       struct dma_stat_ts *ts)
 {
 	struct dma_async_tx_descriptor *desc;
 	struct device *dev = &dma_dev->pdev->dev;
 	struct scatterlist sg;
 	struct dma_slave_config conf;
-	dma_cookie_t cookie;
+	u64 t = dma_stat_now(ts);
 
-	/* Usr buf must be an alias to iodma buf */
-	dma_addr_t ddst = _translate_buf(dma_dev, dst, count);
-	if (!ddst) {
-		dev_err(dev, "_translate_buf() error!\n");
-		return -EINVAL;
-	}
-
-	/* Ensure CPU is done with reads */
-	rmb();
-
-	sg.offset = 0;
+	sg_init_table(&sg, 1);
 	sg.length = count;
-	sg.dma_address = ddst;
+	sg_dma_address(&sg) = daddr;
+	sg_dma_len(&sg) = count;
 
 	memzero_explicit(&conf, sizeof(struct dma_slave_config));
-	conf.direction = DMA_DEV_TO_MEM;
-	conf.src_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);	
+	conf.direction = dir;
+	if (dir == DMA_DEV_TO_MEM)
+		conf.src_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
+	else
+		conf.dst_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
 	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
 	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
 	conf.src_maxburst = 16;
 	conf.dst_maxburst = 16;
 
 	if (dmaengine_slave_config(dma_dev->dmach, &conf) < 0) {
-		dev_err(dev, "dmaengine_slave_config() failure");
-		return -EINVAL;
+		dev_err(dev, "dmaengine_slave_config() failure\n");
+		return NULL;
 	}
+	t = dma_stat_add(ts, DMA_STAT_CONFIG, t);
 
 	desc = dmaengine_prep_slave_sg(dma_dev->dmach,
 				       &sg,
 				       1,
-				       DMA_DEV_TO_MEM,
-				       DMA_INTERRUPT);
+				       dir,
+				       DMA_PREP_INTERRUPT);
 
-	if (IS_ERR(desc)) {
+/*
+	desc = dmaengine_prep_dma_memcpy(dmach,
+					 dst,
+					 dsrc,
+					 count,
+					 DMA_INTERRUPT);
+*/
+	if (IS_ERR_OR_NULL(desc)) {
 		dev_err(dev, "dmaengine_prep_slave_sg() failure\n");
-		return -EIO;
+		return NULL;
 	}
 
 	dma_drv_hack_chdir(desc);
+	if (fifo == FIFO_ADDR)
+		dma_drv_hack_setfifo(desc, dir);
+	dma_stat_add(ts, DMA_STAT_PREP, t);
 
-	init_completion(&dma_dev->transfer_ok);
-	desc->callback = dma_dev->dma_callback;
-	desc->callback_param = &dma_dev->transfer_ok;
+	return desc;
+}
+
+/* Contiguous IOBUF range as one sg entry for dma_stripe_xfer() */
+static int dma_stripe_iobuf(struct plng_dma_device *dma_dev,
+			    unsigned nstripes,
+			    dma_addr_t daddr,
+			    loff_t br_offset,
+			    size_t count,
+			    enum dma_transfer_direction dir)
+{
+	struct scatterlist sg;
+
+	sg_init_table(&sg, 1);
+	sg.length = count;
+	sg_dma_address(&sg) = daddr;
+	sg_dma_len(&sg) = count;
+	return dma_stripe_xfer(dma_dev, nstripes, &sg, 1, count,
+			       br_offset, dir);
+}
+
+/**********************/
+/******** READ ********/
+/**********************/
+ssize_t dma_read(struct plng_dma_ctx *ctx,
+		 void __user * dst,
+		 const loff_t br_offset,
+		 size_t count)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_async_tx_descriptor *desc;
+	struct device *dev = &dma_dev->pdev->dev;
+	struct dma_stat_ts ts = {
+		.br_offset = br_offset,
+		.len = count,
+		.mode = DMA_OPMODE,
+		.fifo = ctx->fifo_mode,
+		.dir = DMA_DEV_TO_MEM,
+	};
+	u64 t0 = dma_stat_now(&ts);
+	unsigned nstripes;
+	int ret;
 
-	dma_drv_hack_setfifo(desc, DMA_DEV_TO_MEM);
+	trace_dma_drv_submit(&ts);
 
-	cookie = dmaengine_submit(desc);
+	/* Usr buf must be an alias to iodma buf */
+	dma_addr_t ddst = dma_translate_buf(ctx, dst, count);
+	if (!ddst) {
+		dev_err(dev, "dma_translate_buf() error!\n");
+		return -EINVAL;
+	}
 
-	if (0 != dma_submit_error(cookie)) {
-		dev_err(dev, "dma_submit() failure\n");
+	/* Ensure CPU is done with reads */
+	rmb();
+	dma_buf_sync_dev(ctx, ddst, count, DMA_DEV_TO_MEM);
+
+	nstripes = dma_buf_stripes(ctx, count);
+	if (nstripes > 1) {
+		ret = dma_stripe_iobuf(dma_dev, nstripes, ddst, br_offset,
+				       count, DMA_DEV_TO_MEM);
+		dma_buf_sync_cpu(ctx, ddst, count, DMA_DEV_TO_MEM);
+		return ret ? ret : count;
+	}
+
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		return ret;
+
+	desc = dma_prep_iobuf(dma_dev, ddst, br_offset, count,
+			      DMA_DEV_TO_MEM, ctx->fifo_mode, &ts);
+	if (!desc) {
+		dma_chan_put(dma_dev);
 		return -EIO;
 	}
+	dma_buf_hack_cache(ctx, desc, DMA_DEV_TO_MEM);
 
-	dma_async_issue_pending(dma_dev->dmach);
-	dev_info(dev, "Start waiting...\n");
+	ret = dma_submit_and_wait(dma_dev, desc, &ts);
+	dma_buf_sync_cpu(ctx, ddst, count, DMA_DEV_TO_MEM);
+	if (ret)
+		return ret;
 
-	wait_for_completion(&dma_dev->transfer_ok);
+	dma_stat_add(&ts, DMA_STAT_TOTAL, t0);
+	dma_stat_account(dma_dev, &ts);
+	trace_dma_drv_released(&ts);
 
-	/* CACHE SYNC HERE!!! */
-/*
-	dma_sync_single_for_cpu(dma_dev->dmach->device->dev,
-				ddst,
-				count,
-				DMA_FROM_DEVICE);
-*/
 	return count;
 }
 
 /**********************/
 /******* WRITE ********/
 /**********************/
-ssize_t dma_write(struct plng_dma_device * dma_dev,
+ssize_t dma_write(struct plng_dma_ctx *ctx,
 		  const void __user * src,
 		  loff_t br_offset,
 		  size_t count)
 {
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
 	struct dma_async_tx_descriptor *desc;
-	struct scatterlist sg;
-	struct dma_slave_config conf;
 	struct device *dev = &dma_dev->pdev->dev;
-	dma_cookie_t cookie;
+	struct dma_stat_ts ts = {
+		.br_offset = br_offset,
+		.len = count,
+		.mode = DMA_OPMODE,
+		.fifo = ctx->fifo_mode,
+		.dir = DMA_MEM_TO_DEV,
+	};
+	u64 t0 = dma_stat_now(&ts);
+	unsigned nstripes;
+	int ret;
+
+	trace_dma_drv_submit(&ts);
 
 	/* Usr buf must be an alias to iodma buf */
-	dma_addr_t dsrc = _translate_buf(dma_dev, src, count);
+	dma_addr_t dsrc = dma_translate_buf(ctx, src, count);
 	if (!dsrc) {
-		dev_err(dev, "_translate_buf() error!\n");
-		return -EINVAL;
-	}
-
-	sg.offset = 0;
-	sg.length = count;
-	sg.dma_address = dsrc;
-
-	memzero_explicit(&conf, sizeof(struct dma_slave_config));
-	conf.direction = DMA_MEM_TO_DEV;
-	conf.dst_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
-	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-	conf.src_maxburst = 16;
-	conf.dst_maxburst = 16;
-
-	if (dmaengine_slave_config(dma_dev->dmach, &conf) < 0) {
-		dev_err(dev, "dmaengine_slave_config() failure\n");
+		dev_err(dev, "dma_translate_buf() error!\n");
 		return -EINVAL;
 	}
 
-	desc = dmaengine_prep_slave_sg(dma_dev->dmach,
-				       &sg,
-				       1,
-				       DMA_MEM_TO_DEV,
-				       DMA_INTERRUPT);
+	dma_buf_sync_dev(ctx, dsrc, count, DMA_MEM_TO_DEV);
 
-/*
-	desc = dmaengine_prep_dma_memcpy(dmach,
-					 dst,
-					 dsrc,
-					 count,
-					 DMA_INTERRUPT);
-*/
-	if (IS_ERR(desc)) {
-		dev_err(dev, "dmaengine_prep_slave_sg() failure\n");
-		return -EIO;
+	nstripes = dma_buf_stripes(ctx, count);
+	if (nstripes > 1) {
+		ret = dma_stripe_iobuf(dma_dev, nstripes, dsrc, br_offset,
+				       count, DMA_MEM_TO_DEV);
+		return ret ? ret : count;
 	}
 
-	/* CACHE SYNC HERE!!! */
-	dma_sync_single_for_device(dma_dev->dmach->device->dev,
-				   dsrc,
-				   count,
-				   DMA_TO_DEVICE);
-
-	dma_drv_hack_chdir(desc);
-
-	init_completion(&dma_dev->transfer_ok);
-	desc->callback = dma_dev->dma_callback;
-	desc->callback_param = &dma_dev->transfer_ok;
-	cookie = dmaengine_submit(desc);
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		return ret;
 
-	if (dma_submit_error(cookie)) {
-		dev_err(dev, "dma_submit_error() failure\n");
+	desc = dma_prep_iobuf(dma_dev, dsrc, br_offset, count,
+			      DMA_MEM_TO_DEV, ctx->fifo_mode, &ts);
+	if (!desc) {
+		dma_chan_put(dma_dev);
 		return -EIO;
 	}
+	dma_buf_hack_cache(ctx, desc, DMA_MEM_TO_DEV);
 
-	dev_info(dev, "Start waiting...\n");
+	ret = dma_submit_and_wait(dma_dev, desc, &ts);
+	if (ret)
+		return ret;
 
-	dma_async_issue_pending(dma_dev->dmach);
-	wait_for_completion(&dma_dev->transfer_ok);
+	dma_stat_add(&ts, DMA_STAT_TOTAL, t0);
+	dma_stat_account(dma_dev, &ts);
+	trace_dma_drv_released(&ts);
 
 	return count;
 }
@@ -210,33 +421,250 @@ ssize_t dma_write(struct plng_dma_device * dma_dev,
 /**********************/
 /******** MMAP ********/
 /**********************/
-int dma_mmap(struct plng_dma_device * dma_dev,
-		 struct file *filp,
-		 struct vm_area_struct *vma)
+/* Any number of mappings, they hold no state */
+static int dma_mmap_bridge(struct plng_dma_device *dma_dev,
+			   struct vm_area_struct *vma,
+			   size_t offset)
+{
+	size_t size = vma->vm_end - vma->vm_start;
+	bool wc = offset >= DMADRV_BRIDGE_WC_OFFSET;
+
+	offset -= wc ? DMADRV_BRIDGE_WC_OFFSET : DMADRV_BRIDGE_OFFSET;
+	if (offset >= dma_dev->base_size || size > dma_dev->base_size - offset)
+		return -EINVAL;
+	if (!PAGE_ALIGNED(dma_dev->base_phys))
+		return -EINVAL;
+
+	/* simulated bridge is cached RAM, keep its attributes */
+	if (!dma_dev->sim)
+		vma->vm_page_prot = wc ? pgprot_writecombine(vma->vm_page_prot) :
+			pgprot_device(vma->vm_page_prot);
+
+	if (io_remap_pfn_range(vma, vma->vm_start,
+			       (dma_dev->base_phys + offset) >> PAGE_SHIFT,
+			       size, vma->vm_page_prot)) {
+		dev_err(&dma_dev->pdev->dev, "io_remap_pfn_range() failure\n");
+		return -EAGAIN;
+	}
+	return 0;
+}
+
+int dma_mmap(struct plng_dma_ctx *ctx,
+	     struct file *filp,
+	     struct vm_area_struct *vma)
 {
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct device *dmadev = dma_dev->dmach->device->dev;
+	struct dmadrv_ring *ring;
 	size_t pfn;
 	size_t offset = vma->vm_pgoff << PAGE_SHIFT;
 	size_t size = vma->vm_end - vma->vm_start;
+	int ret;
 
-	/* if (drv_vma) */
-	/* return -EINVAL; */
-	if (offset >= IOBUF_SIZE)
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	if (offset >= DMADRV_BRIDGE_OFFSET)
+		return dma_mmap_bridge(dma_dev, vma, offset);
+
+	/* cyclic ring header page */
+	if (offset == DMADRV_RING_OFFSET) {
+		if (size != PAGE_SIZE)
+			return -EINVAL;
+		ring = dma_cyclic_ring(ctx);
+		if (!ring)
+			return -ENOMEM;
+		pfn = virt_to_phys(ring) >> PAGE_SHIFT;
+		if (remap_pfn_range(vma, vma->vm_start, pfn, PAGE_SIZE,
+				    vma->vm_page_prot)) {
+			dev_err(&dma_dev->pdev->dev,
+				"remap_pfn_range() failure\n");
+			return -EAGAIN;
+		}
+		return 0;
+	}
+
+	mutex_lock(&ctx->lock);
+	ret = dma_buf_alloc(ctx);
+	mutex_unlock(&ctx->lock);
+	if (ret)
+		return ret;
+
+	if (offset >= ctx->buf_size)
 		return -EINVAL;
-	if (size > (IOBUF_SIZE - offset))
+	if (size > (ctx->buf_size - offset))
 		return -EINVAL;
-	/* we can use page_to_pfn on the struct page structure
-	 * returned by virt_to_page */
-	/* pfn = page_to_pfn (virt_to_page (buffer + offset)); */
-	/* Or make PAGE_SHIFT bits right-shift on the physical
-	 * address returned by virt_to_phys */
-	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
-	pfn = virt_to_phys(dma_dev->buf + offset) >> PAGE_SHIFT;
-	if (remap_pfn_range(vma, vma->vm_start, pfn, size, vma->vm_page_prot)) {
-		dev_err(&dma_dev->pdev->dev, "remap_pfn_range() failure\n");
-		return -EAGAIN;
+
+	if (ctx->coherency != COHERENT_IOBUF) {
+		pfn = (virt_to_phys(ctx->buf) >> PAGE_SHIFT) + vma->vm_pgoff;
+		if (remap_pfn_range(vma, vma->vm_start, pfn, size,
+				    vma->vm_page_prot)) {
+			dev_err(&dma_dev->pdev->dev,
+				"remap_pfn_range() failure\n");
+			return -EAGAIN;
+		}
+	} else {
+		/* honours vm_pgoff */
+		ret = dma_mmap_coherent(dmadev, vma, ctx->buf, ctx->dma_buf,
+					ctx->buf_size);
+		if (ret) {
+			dev_err(&dma_dev->pdev->dev,
+				"dma_mmap_coherent() failure\n");
+			return ret;
+		}
+	}
+	/* lets dma_translate_buf() recognize every mapping of ctx */
+	vma->vm_ops = &dma_vm_ops;
+	vma->vm_private_data = ctx;
+	return 0;
+}
+
+/**********************/
+/******* IOBUF ********/
+/**********************/
+/*
+ * CACHED_IOBUF and ACP_IOBUF: page allocator memory, cacheable in the
+ * linear map. ACP addresses it through the window, CACHED through a
+ * streaming mapping synced per transfer.
+ */
+static int dma_buf_alloc_cached(struct plng_dma_ctx *ctx)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct device *dev = &dma_dev->pdev->dev;
+	struct device *dmadev = dma_dev->dmach->device->dev;
+	phys_addr_t phys;
+
+	ctx->buf = alloc_pages_exact(ctx->buf_size,
+				     GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN);
+	if (!ctx->buf) {
+		dev_err(dev, "alloc_pages_exact(%zu) failure\n",
+			ctx->buf_size);
+		return -ENOMEM;
+	}
+
+	if (ctx->coherency == ACP_IOBUF) {
+		phys = virt_to_phys(ctx->buf);
+		if (phys + ctx->buf_size > dma_dev->acp_size) {
+			dev_err(dev, "IOBUF outside of the ACP window\n");
+			goto FREE_PAGES;
+		}
+		ctx->dma_buf = dma_dev->acp_base + phys;
+		return 0;
+	}
+
+	ctx->dma_buf = dma_map_single(dmadev, ctx->buf, ctx->buf_size,
+				      DMA_BIDIRECTIONAL);
+	if (dma_mapping_error(dmadev, ctx->dma_buf)) {
+		dev_err(dev, "dma_map_single() failure\n");
+		goto FREE_PAGES;
 	}
-	dma_dev->usr_vma = vma;
 	return 0;
+
+FREE_PAGES:
+	free_pages_exact(ctx->buf, ctx->buf_size);
+	ctx->buf = NULL;
+	return -ENOMEM;
+}
+
+/* ctx->lock held */
+int dma_buf_alloc(struct plng_dma_ctx *ctx)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct device *dmadev = dma_dev->dmach->device->dev;
+
+	if (ctx->buf)
+		return 0;
+
+	if (ctx->coherency != COHERENT_IOBUF)
+		return dma_buf_alloc_cached(ctx);
+
+	/* comes from CMA when the platform has it */
+	ctx->buf = dma_alloc_coherent(dmadev, ctx->buf_size, &ctx->dma_buf,
+				      GFP_KERNEL);
+	if (!ctx->buf) {
+		dev_err(&dma_dev->pdev->dev,
+			"dma_alloc_coherent(%zu) failure\n", ctx->buf_size);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+void dma_buf_free(struct plng_dma_ctx *ctx)
+{
+	struct device *dmadev = ctx->dma_dev->dmach->device->dev;
+
+	if (!ctx->buf)
+		return;
+
+	if (ctx->coherency == COHERENT_IOBUF) {
+		dma_free_coherent(dmadev, ctx->buf_size, ctx->buf,
+				  ctx->dma_buf);
+	} else {
+		if (ctx->coherency == CACHED_IOBUF)
+			dma_unmap_single(dmadev, ctx->dma_buf, ctx->buf_size,
+					 DMA_BIDIRECTIONAL);
+		free_pages_exact(ctx->buf, ctx->buf_size);
+	}
+	ctx->buf = NULL;
+}
+
+/* DMADRV_SYNC_FOR_CPU/DEV */
+long dma_buf_sync(struct plng_dma_ctx *ctx, struct dmadrv_sync __user *usync,
+		  bool for_cpu)
+{
+	enum dma_transfer_direction dir;
+	struct dmadrv_sync req;
+	long ret = 0;
+
+	if (copy_from_user(&req, usync, sizeof(req)))
+		return -EFAULT;
+	if (req.dir >= INVALID_XFER || req.flags || !req.len)
+		return -EINVAL;
+	dir = req.dir == XFER_READ ? DMA_DEV_TO_MEM : DMA_MEM_TO_DEV;
+
+	mutex_lock(&ctx->lock);
+	if (!ctx->buf || req.offset >= ctx->buf_size ||
+	    req.len > ctx->buf_size - req.offset)
+		ret = -EINVAL;
+	else if (for_cpu)
+		dma_buf_sync_cpu(ctx, ctx->dma_buf + req.offset, req.len, dir);
+	else
+		dma_buf_sync_dev(ctx, ctx->dma_buf + req.offset, req.len, dir);
+	mutex_unlock(&ctx->lock);
+	return ret;
+}
+
+long dma_buf_set_coherency(struct plng_dma_ctx *ctx, unsigned long mode)
+{
+	long ret = 0;
+
+	if (mode >= INVALID_IOBUF)
+		return -EINVAL;
+	if (mode == ACP_IOBUF && !ctx->dma_dev->acp_size)
+		return -EOPNOTSUPP;
+
+	mutex_lock(&ctx->lock);
+	if (ctx->buf)
+		ret = -EBUSY;
+	else
+		ctx->coherency = mode;
+	mutex_unlock(&ctx->lock);
+	return ret;
+}
+
+long dma_buf_set_size(struct plng_dma_ctx *ctx, unsigned long size)
+{
+	long ret = 0;
+
+	if (!size || size > IOBUF_SIZE_LIMIT || !PAGE_ALIGNED(size))
+		return -EINVAL;
+
+	mutex_lock(&ctx->lock);
+	if (ctx->buf)
+		ret = -EBUSY;
+	else
+		ctx->buf_size = size;
+	mutex_unlock(&ctx->lock);
+	return ret;
 }
 
 /**********************/
@@ -245,8 +673,10 @@ int dma_mmap(struct plng_dma_device * dma_dev,
 int dma_init(struct plng_dma_device *dma_dev)
 {
 	int ret;
+	unsigned i;
+	char name[8];
 	dma_cap_mask_t mask;
-	struct dma_chan *dmach;
+	struct dma_chan *dmach, *stripe_ch;
 	struct platform_device *pdev = dma_dev->pdev;
 	struct device *dev = &pdev->dev;
 
@@ -254,23 +684,56 @@ int dma_init(struct plng_dma_device *dma_dev)
 	dma_cap_set(DMA_SLAVE, mask);
 	dmach = dma_request_slave_channel(dev, "rxtx");
 
-	if (IS_ERR(dmach)) {
+	if (IS_ERR_OR_NULL(dmach)) {
 		dev_err(dev, "dma_request_slave_channel() failure");
 		return -ENODEV;
 	}
 
 	dma_dev->dmach = dmach;
+	dma_dev->dmachs[0] = dmach;
+
+	/* optional "rxtx1".."rxtx7" for striping, same PL330 */
+	for (i = 1; i != DMA_DRV_CHAN_MAX; i++) {
+		snprintf(name, sizeof(name), "rxtx%u", i);
+		stripe_ch = dma_request_slave_channel(dev, name);
+		if (IS_ERR_OR_NULL(stripe_ch))
+			break;
+		dma_dev->dmachs[i] = stripe_ch;
+	}
+	dma_dev->nchans = i;
+
+	dma_dev->stripes = 1;
+	of_property_read_u32(dev->of_node, "plng,dma-stripes",
+			     &dma_dev->stripes);
+	dma_dev->stripes = clamp(dma_dev->stripes, 1U, dma_dev->nchans);
+	dev_info(dev, "%u channels, %u stripes\n", dma_dev->nchans,
+		 dma_dev->stripes);
+
+	/* Cyclone V: the ACP ID mapper window covers the first 1 GiB */
+	if (!of_property_read_u32(dev->of_node, "plng,acp-base",
+				  &dma_dev->acp_base)) {
+		dma_dev->acp_size = SZ_1G;
+		of_property_read_u32(dev->of_node, "plng,acp-size",
+				     &dma_dev->acp_size);
+		dev_info(dev, "ACP window 0x%08x, %u MiB\n",
+			 dma_dev->acp_base, dma_dev->acp_size >> 20);
+	}
 
 	BUG_ON(!dma_dev->base);
 
+	/* simulated bridge is RAM with a bus address already */
+	if (dma_dev->sim)
+		return 0;
+
 	dma_dev->dma_base = dma_map_resource(dmach->device->dev,
-					     (phys_addr_t)dma_dev->base,
+					     dma_dev->base_phys,
 					     dma_dev->base_size,
 					     DMA_BIDIRECTIONAL, 0);
 	
 	if (dma_mapping_error(dmach->device->dev, dma_dev->dma_base)) {
 		dev_err(dev, "dma_map_resource() fail");
-		return -ENOMEM;
+		ret = -ENOMEM;
+		goto RELEASE_CHANS;
 	}
 
 	if (!dma_set_mask(dmach->device->dev, 0xffffff)) {
@@ -279,17 +742,6 @@ int dma_init(struct plng_dma_device *dma_dev)
 		goto IOREG_UNMAP;
 	}
 
-	BUG_ON(!dma_dev->buf);
-
-        dma_dev->dma_buf = dma_map_single(dmach->device->dev, dma_dev->buf,
-			       IOBUF_SIZE, DMA_BIDIRECTIONAL);
-
-	if (dma_mapping_error(dmach->device->dev, dma_dev->dma_buf)) {
-		dev_err(dev, "dma_map_single() fail");
-		ret = -ENOMEM;
-		goto IOREG_UNMAP;
-	}
-
 	return 0;
 
 IOREG_UNMAP:
@@ -297,6 +749,9 @@ IOREG_UNMAP:
 			   dma_dev->dma_base,
 			   dma_dev->base_size,
 			   DMA_BIDIRECTIONAL, 0);
+RELEASE_CHANS:
+	for (i = 0; i != dma_dev->nchans; i++)
+		dma_release_channel(dma_dev->dmachs[i]);
 	return ret;
 }
 
@@ -305,14 +760,20 @@ IOREG_UNMAP:
 /**********************/
 void dma_fini(struct plng_dma_device *dma_dev)
 {
-	dmaengine_terminate_sync(dma_dev->dmach);	/* always success */
+	unsigned i;
 
-	dma_unmap_resource(dma_dev->dmach->device->dev,
-			   dma_dev->dma_base,
-			   dma_dev->base_size,
-			   DMA_BIDIRECTIONAL, 0);
-	dma_unmap_single(dma_dev->dmach->device->dev, dma_dev->dma_buf,
-			 IOBUF_SIZE, DMA_BIDIRECTIONAL);
+	for (i = 0; i != dma_dev->nchans; i++)
+		dmaengine_terminate_sync(dma_dev->dmachs[i]);	/* always success */
+	dma_aio_fini(dma_dev);
+
+	if (!dma_dev->sim)
+		dma_unmap_resource(dma_dev->dmach->device->dev,
+				   dma_dev->dma_base,
+				   dma_dev->base_size,
+				   DMA_BIDIRECTIONAL, 0);
+
+	for (i = 0; i != dma_dev->nchans; i++)
+		dma_release_channel(dma_dev->dmachs[i]);
 	return;
 }
 
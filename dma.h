@@ -10,19 +10,60 @@
 #include <linux/types.h>
 #include "plng_dma_device.h"
 
-ssize_t dma_read(struct plng_dma_device *dma_dev,
+struct dma_stat_ts;
+
+dma_addr_t dma_translate_buf(struct plng_dma_ctx *ctx,
+			     const void __user * buf,
+			     size_t bcount);
+
+int dma_chan_get(struct plng_dma_device *dma_dev);
+void dma_chan_put(struct plng_dma_device *dma_dev);
+dma_cookie_t dma_chan_submit(struct plng_dma_device *dma_dev,
+			     struct dma_async_tx_descriptor *desc);
+int dma_chan_idle(struct plng_dma_device *dma_dev);
+
+int dma_submit_and_wait(struct plng_dma_device *dma_dev,
+			struct dma_async_tx_descriptor *desc,
+			struct dma_stat_ts *ts);
+
+void dma_buf_sync_dev(struct plng_dma_ctx *ctx, dma_addr_t daddr,
+		      size_t len, enum dma_transfer_direction dir);
+void dma_buf_sync_cpu(struct plng_dma_ctx *ctx, dma_addr_t daddr,
+		      size_t len, enum dma_transfer_direction dir);
+void dma_buf_hack_cache(struct plng_dma_ctx *ctx,
+			struct dma_async_tx_descriptor *desc,
+			enum dma_transfer_direction dir);
+unsigned dma_buf_stripes(struct plng_dma_ctx *ctx, size_t count);
+
+struct dma_async_tx_descriptor *
+dma_prep_iobuf(struct plng_dma_device *dma_dev,
+	       dma_addr_t daddr,
+	       loff_t br_offset,
+	       size_t count,
+	       enum dma_transfer_direction dir,
+	       unsigned long fifo,
+	       struct dma_stat_ts *ts);
+
+ssize_t dma_read(struct plng_dma_ctx *ctx,
 		 void __user * dst,
 		 const loff_t br_offset,
 		 size_t count);
 
-ssize_t dma_write(struct plng_dma_device * dma_dev,
+ssize_t dma_write(struct plng_dma_ctx *ctx,
 		  const void __user * src,
 		  loff_t br_offset,
 		  size_t count);
 
-int dma_mmap(struct plng_dma_device * dma_dev,
-		 struct file *filp,
-		 struct vm_area_struct *vma);
+int dma_mmap(struct plng_dma_ctx *ctx,
+	     struct file *filp,
+	     struct vm_area_struct *vma);
+
+int dma_buf_alloc(struct plng_dma_ctx *ctx);
+void dma_buf_free(struct plng_dma_ctx *ctx);
+long dma_buf_sync(struct plng_dma_ctx *ctx, struct dmadrv_sync __user *usync,
+		  bool for_cpu);
+long dma_buf_set_coherency(struct plng_dma_ctx *ctx, unsigned long mode);
+long dma_buf_set_size(struct plng_dma_ctx *ctx, unsigned long size);
 
 int dma_init(struct plng_dma_device *dma_dev);
 void dma_fini(struct plng_dma_device *dma_dev);
@@ -0,0 +1,213 @@
+/**
+ * @file:	dma_aio.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/fs.h>
+#include <linux/uio.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+
+#include "dma.h"
+#include "dma_pg.h"
+#include "dma_aio.h"
+#include "dma_stripe.h"
+#include "dma_stat.h"
+#include "dma_trace.h"
+#include "log.h"
+
+/*
+ * One queued DMAPG transfer, owned by the callback once submitted.
+ * On dma_dev->aio_list until its kiocb is completed.
+ */
+struct dma_aio {
+	struct list_head node;
+	bool fired;			/* callback ran, aio_lock */
+	struct kiocb *iocb;
+	struct plng_dma_device *dma_dev;
+	usrbuf_t *usrbuf;
+	dma_cookie_t cookie;
+	u64 t0;
+	u64 submit_ns;
+	u64 irq_ns;
+	struct dma_stat_ts ts;
+	struct work_struct work;
+};
+
+/**********************/
+/****** COMPLETE ******/
+/**********************/
+/* Unpins, completes the kiocb and leaves its list */
+static void aio_finish(struct dma_aio *aio, long ret)
+{
+	struct plng_dma_device *dma_dev = aio->dma_dev;
+
+	put_usr_buf(dma_dev, aio->usrbuf);
+	if (ret >= 0) {
+		dma_stat_add(&aio->ts, DMA_STAT_TOTAL, aio->t0);
+		dma_stat_account(dma_dev, &aio->ts);
+		trace_dma_drv_released(&aio->ts);
+	}
+	aio->iocb->ki_complete(aio->iocb, ret, 0);
+
+	spin_lock_irq(&dma_dev->aio_lock);
+	list_del(&aio->node);
+	if (list_empty(&dma_dev->aio_list))
+		wake_up_all(&dma_dev->aio_wait);
+	spin_unlock_irq(&dma_dev->aio_lock);
+	kfree(aio);
+}
+
+/* Unmapping and unpinning are left to process context */
+static void aio_work(struct work_struct *work)
+{
+	struct dma_aio *aio = container_of(work, struct dma_aio, work);
+	long ret = aio->ts.len;
+
+	trace_dma_drv_woken(&aio->ts);
+	aio->ts.ns[DMA_STAT_HW] += aio->irq_ns - aio->submit_ns;
+	dma_stat_add(&aio->ts, DMA_STAT_WAKE, aio->irq_ns);
+
+	if (dmaengine_tx_status(aio->dma_dev->dmach, aio->cookie, NULL) !=
+	    DMA_COMPLETE)
+		ret = -EIO;
+	aio_finish(aio, ret);
+}
+
+static void aio_callback(void *param)
+{
+	struct dma_aio *aio = param;
+	unsigned long flags;
+
+	aio->irq_ns = ktime_get_ns();
+	trace_dma_drv_callback(&aio->ts);
+	spin_lock_irqsave(&aio->dma_dev->aio_lock, flags);
+	aio->fired = true;
+	spin_unlock_irqrestore(&aio->dma_dev->aio_lock, flags);
+	queue_work(system_highpri_wq, &aio->work);
+}
+
+/**********************/
+/******* SUBMIT *******/
+/**********************/
+/*
+ * DMAPG transfer of iter for a non-sync kiocb: pinned, mapped and
+ * queued on the channel, then -EIOCBQUEUED. The kiocb is completed
+ * from aio_work(). Striped transfers are waited for here.
+ */
+ssize_t dma_aio_xfer(struct plng_dma_ctx *ctx,
+		     struct kiocb *iocb,
+		     struct iov_iter *iter,
+		     enum dma_transfer_direction dir)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_async_tx_descriptor *desc;
+	size_t count = iov_iter_count(iter);
+	struct dma_aio *aio;
+	ssize_t ret;
+
+	if (!count || dma_stripe_count(ctx, count) > 1)
+		return dma_xfer_pg_iter(ctx, iter, iocb->ki_pos, dir);
+
+	aio = kzalloc(sizeof(*aio), GFP_KERNEL);
+	if (!aio)
+		return -ENOMEM;
+	aio->iocb = iocb;
+	aio->dma_dev = dma_dev;
+	aio->ts.br_offset = iocb->ki_pos;
+	aio->ts.len = count;
+	aio->ts.mode = DMAPG_OPMODE;
+	aio->ts.fifo = ctx->fifo_mode;
+	aio->ts.dir = dir;
+	INIT_WORK(&aio->work, aio_work);
+	aio->t0 = ktime_get_ns();
+	trace_dma_drv_submit(&aio->ts);
+
+	aio->usrbuf = get_usr_iter(dma_dev, ctx->pg_arena, iter,
+				   dir == DMA_DEV_TO_MEM ?
+				   DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	if (!aio->usrbuf) {
+		ret = -EFAULT;
+		goto FREE_AIO;
+	}
+	dma_stat_add(&aio->ts, DMA_STAT_PIN, aio->t0);
+	trace_dma_drv_pin_done(&aio->ts);
+	trace_dma_drv_sg_mapped(&aio->ts, aio->usrbuf->sgnum);
+	ctx->last_sgnum = aio->usrbuf->sgnum;
+
+	desc = dma_pg_prep_sg(ctx, aio->usrbuf->sgs, aio->usrbuf->sgnum,
+			      iocb->ki_pos, dir, &aio->ts);
+	if (IS_ERR(desc)) {
+		ret = PTR_ERR(desc);
+		goto PUT_USR_BUF;
+	}
+
+	desc->callback = aio_callback;
+	desc->callback_param = aio;
+	spin_lock_irq(&dma_dev->aio_lock);
+	list_add_tail(&aio->node, &dma_dev->aio_list);
+	spin_unlock_irq(&dma_dev->aio_lock);
+	aio->submit_ns = ktime_get_ns();
+	aio->cookie = dma_chan_submit(dma_dev, desc);
+	dma_chan_put(dma_dev);
+	if (dma_submit_error(aio->cookie)) {
+		spin_lock_irq(&dma_dev->aio_lock);
+		list_del(&aio->node);
+		spin_unlock_irq(&dma_dev->aio_lock);
+		ret = -EIO;
+		goto PUT_USR_BUF;
+	}
+	/* aio may be gone already */
+	return -EIOCBQUEUED;
+
+PUT_USR_BUF:
+	put_usr_buf(dma_dev, aio->usrbuf);
+FREE_AIO:
+	kfree(aio);
+	return ret;
+}
+
+/**********************/
+/******** INIT ********/
+/**********************/
+void dma_aio_init(struct plng_dma_device *dma_dev)
+{
+	spin_lock_init(&dma_dev->aio_lock);
+	INIT_LIST_HEAD(&dma_dev->aio_list);
+	init_waitqueue_head(&dma_dev->aio_wait);
+}
+
+/*
+ * Channels terminated: descriptors dropped by the terminate never call
+ * back, their kiocbs get -EIO here. Waits for the ones already handed
+ * to aio_work().
+ */
+void dma_aio_fini(struct plng_dma_device *dma_dev)
+{
+	struct dma_aio *aio, *tmp;
+	LIST_HEAD(dropped);
+
+	spin_lock_irq(&dma_dev->aio_lock);
+	list_for_each_entry_safe(aio, tmp, &dma_dev->aio_list, node) {
+		if (!aio->fired)
+			list_move_tail(&aio->node, &dropped);
+	}
+	spin_unlock_irq(&dma_dev->aio_lock);
+
+	list_for_each_entry_safe(aio, tmp, &dropped, node)
+		aio_finish(aio, -EIO);
+
+	wait_event(dma_dev->aio_wait, list_empty_careful(&dma_dev->aio_list));
+}
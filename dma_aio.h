@@ -0,0 +1,24 @@
+/**
+ * @file:	dma_aio.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_AIO_H)
+#define DMA_AIO_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/uio.h>
+#include <linux/dmaengine.h>
+#include "plng_dma_device.h"
+
+ssize_t dma_aio_xfer(struct plng_dma_ctx *ctx,
+		     struct kiocb *iocb,
+		     struct iov_iter *iter,
+		     enum dma_transfer_direction dir);
+
+void dma_aio_init(struct plng_dma_device *dma_dev);
+void dma_aio_fini(struct plng_dma_device *dma_dev);
+
+#endif /* !defined(DMA_AIO_H) */
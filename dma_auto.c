@@ -0,0 +1,343 @@
+/**
+ * @file:	dma_auto.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/io.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/scatterlist.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+
+#include "dma.h"
+#include "dma_pg.h"
+#include "dma_auto.h"
+#include "log.h"
+
+/* used until the first calibration */
+#define DMA_AUTO_PIO_MAX	(512U)
+#define DMA_AUTO_PG_MIN		(4096U)
+
+#define DMA_AUTO_MIN_SIZE	(64U)
+#define DMA_AUTO_RUNS		(8U)
+
+/**********************/
+/******* SELECT *******/
+/**********************/
+/*
+ * Small transfers go PIO. Larger ones use IOBUF directly when buf is
+ * a word aligned alias of it, otherwise DMAPG once pinning pays off.
+ */
+unsigned long dma_auto_mode(struct plng_dma_ctx *ctx,
+			    const void __user *buf,
+			    size_t count)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+
+	if (count <= READ_ONCE(dma_dev->auto_pio_max))
+		return DUMB_OPMODE;
+	if (!(((unsigned long)buf | count) & 3) &&
+	    dma_translate_buf(ctx, buf, count))
+		return DMA_OPMODE;
+	if (count >= READ_ONCE(dma_dev->auto_pg_min))
+		return DMAPG_OPMODE;
+	return DUMB_OPMODE;
+}
+
+/**********************/
+/****** CALIBRATE *****/
+/**********************/
+/* dumb_read() without the user copy */
+static u64 cal_pio(struct plng_dma_device *dma_dev, size_t size)
+{
+	u64 t = ktime_get_ns();
+	size_t off, chunk;
+
+	mutex_lock(&dma_dev->pio_lock);
+	for (off = 0; off != size; off += chunk) {
+		chunk = min_t(size_t, size - off, DMA_PIO_CHUNK);
+		dma_dev->pio->read(dma_dev, dma_dev->pio_buf, off, chunk,
+				   INCR_ADDR);
+	}
+	mutex_unlock(&dma_dev->pio_lock);
+	return ktime_get_ns() - t;
+}
+
+static s64 cal_dma(struct plng_dma_device *dma_dev, dma_addr_t daddr,
+		   size_t size)
+{
+	struct dma_async_tx_descriptor *desc;
+	u64 t = ktime_get_ns();
+	int ret;
+
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		return ret;
+	desc = dma_prep_iobuf(dma_dev, daddr, 0, size, DMA_DEV_TO_MEM,
+			      INCR_ADDR, NULL);
+	if (!desc) {
+		dma_chan_put(dma_dev);
+		return -EIO;
+	}
+	ret = dma_submit_and_wait(dma_dev, desc, NULL);
+	if (ret)
+		return ret;
+	return ktime_get_ns() - t;
+}
+
+/* map + transfer + unmap of scattered pages, pinning not included */
+static s64 cal_pg(struct plng_dma_ctx *ctx, void *vbuf,
+		  struct scatterlist *sgs, size_t size)
+{
+	struct device *dmadev = ctx->dma_dev->dmach->device->dev;
+	size_t i, npages = DIV_ROUND_UP(size, PAGE_SIZE);
+	u64 t = ktime_get_ns();
+	int nents, ret;
+
+	sg_init_table(sgs, npages);
+	for (i = 0; i != npages; i++)
+		sg_set_page(&sgs[i], vmalloc_to_page(vbuf + i * PAGE_SIZE),
+			    min_t(size_t, PAGE_SIZE, size - i * PAGE_SIZE), 0);
+
+	nents = dma_map_sg(dmadev, sgs, npages, DMA_FROM_DEVICE);
+	if (!nents)
+		return -ENOMEM;
+	ret = dma_pg_xfer_sg(ctx, sgs, nents, size, 0, DMA_DEV_TO_MEM,
+			     NULL);
+	dma_unmap_sg(dmadev, sgs, npages, DMA_FROM_DEVICE);
+	if (ret)
+		return ret;
+	return ktime_get_ns() - t;
+}
+
+static u64 cal_best(u64 best, s64 t)
+{
+	return (t >= 0 && (!best || t < best)) ? t : best;
+}
+
+/*
+ * Times PIO, DMA and DMAPG reads of growing size from bridge offset 0
+ * in INCR_ADDR mode. Reads only, writes would clobber FPGA state.
+ * PIO wins up to the first size DMA beats it; DMAPG threshold is the
+ * first size it beats PIO.
+ */
+int dma_auto_calibrate(struct plng_dma_device *dma_dev)
+{
+	struct device *dev = &dma_dev->pdev->dev;
+	struct device *dmadev = dma_dev->dmach->device->dev;
+	struct dma_auto_point *pt;
+	struct plng_dma_ctx *ctx;
+	struct scatterlist *sgs;
+	size_t size, max;
+	dma_addr_t daddr;
+	void *cbuf, *vbuf;
+	u32 pio_max = 0, pg_min = 0;
+	bool pio_lead = true;
+	unsigned i, run;
+	int ret = -ENOMEM;
+
+	max = min3((size_t)DMA_AUTO_MIN_SIZE << (DMA_AUTO_NPTS - 1),
+		   (size_t)dma_dev->base_size, (size_t)IOBUF_SIZE);
+
+	/* transfers run as if from a file opened for calibration */
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->dma_dev = dma_dev;
+	ctx->fifo_mode = INCR_ADDR;
+	ctx->stripes = 1;
+
+	cbuf = dma_alloc_coherent(dmadev, max, &daddr, GFP_KERNEL);
+	if (!cbuf)
+		goto FREE_CTX;
+	vbuf = vmalloc(max);
+	if (!vbuf)
+		goto FREE_COHERENT;
+	sgs = kmalloc_array(DIV_ROUND_UP(max, PAGE_SIZE), sizeof(*sgs),
+			    GFP_KERNEL);
+	if (!sgs)
+		goto FREE_VBUF;
+
+	mutex_lock(&dma_dev->cal_lock);
+	memset(dma_dev->cal, 0, sizeof(dma_dev->cal));
+	ret = 0;
+	for (i = 0, size = DMA_AUTO_MIN_SIZE; size <= max; i++, size <<= 1) {
+		pt = &dma_dev->cal[i];
+		pt->size = size;
+		for (run = 0; run != DMA_AUTO_RUNS; run++) {
+			pt->pio_ns = cal_best(pt->pio_ns, cal_pio(dma_dev, size));
+			pt->dma_ns = cal_best(pt->dma_ns,
+					      cal_dma(dma_dev, daddr, size));
+			pt->pg_ns = cal_best(pt->pg_ns,
+					     cal_pg(ctx, vbuf, sgs, size));
+		}
+		if (!pt->dma_ns || !pt->pg_ns) {
+			dev_err(dev, "calibration transfer failure\n");
+			ret = -EIO;
+			break;
+		}
+		if (pio_lead && pt->pio_ns <= pt->dma_ns)
+			pio_max = size;
+		else
+			pio_lead = false;
+		if (!pg_min && pt->pg_ns < pt->pio_ns)
+			pg_min = size;
+	}
+	mutex_unlock(&dma_dev->cal_lock);
+
+	if (!ret) {
+		WRITE_ONCE(dma_dev->auto_pio_max, pio_max);
+		WRITE_ONCE(dma_dev->auto_pg_min, pg_min ? pg_min : U32_MAX);
+		dev_info(dev, "auto: pio_max %u, pg_min %u\n",
+			 dma_dev->auto_pio_max, dma_dev->auto_pg_min);
+	}
+
+	kfree(sgs);
+FREE_VBUF:
+	vfree(vbuf);
+FREE_COHERENT:
+	dma_free_coherent(dmadev, max, cbuf, daddr);
+FREE_CTX:
+	kfree(ctx);
+	return ret;
+}
+
+/**********************/
+/******* DEBUGFS ******/
+/**********************/
+static int calibrate_show(struct seq_file *s, void *unused)
+{
+	struct plng_dma_device *dma_dev = s->private;
+	struct dma_auto_point *pt;
+	unsigned i;
+
+	seq_puts(s, "size\tpio_ns\tdma_ns\tpg_ns\n");
+	mutex_lock(&dma_dev->cal_lock);
+	for (i = 0; i != DMA_AUTO_NPTS; i++) {
+		pt = &dma_dev->cal[i];
+		if (!pt->size)
+			break;
+		seq_printf(s, "%u\t%llu\t%llu\t%llu\n", pt->size,
+			   pt->pio_ns, pt->dma_ns, pt->pg_ns);
+	}
+	mutex_unlock(&dma_dev->cal_lock);
+	return 0;
+}
+
+static int calibrate_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, calibrate_show, inode->i_private);
+}
+
+/* any write starts a run, reading shows the last one */
+static ssize_t calibrate_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	int ret;
+
+	ret = dma_auto_calibrate(s->private);
+	return ret ? ret : count;
+}
+
+static const struct file_operations calibrate_fops = {
+	.owner = THIS_MODULE,
+	.open = calibrate_open,
+	.read = seq_read,
+	.write = calibrate_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**********************/
+/******** SYSFS *******/
+/**********************/
+static ssize_t auto_pio_max_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dma_dev->auto_pio_max));
+}
+
+static ssize_t auto_pio_max_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+	u32 val;
+
+	if (kstrtou32(buf, 0, &val))
+		return -EINVAL;
+	WRITE_ONCE(dma_dev->auto_pio_max, val);
+	return count;
+}
+static DEVICE_ATTR_RW(auto_pio_max);
+
+static ssize_t auto_pg_min_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dma_dev->auto_pg_min));
+}
+
+static ssize_t auto_pg_min_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+	u32 val;
+
+	if (kstrtou32(buf, 0, &val))
+		return -EINVAL;
+	WRITE_ONCE(dma_dev->auto_pg_min, val);
+	return count;
+}
+static DEVICE_ATTR_RW(auto_pg_min);
+
+static struct attribute *dma_auto_attrs[] = {
+	&dev_attr_auto_pio_max.attr,
+	&dev_attr_auto_pg_min.attr,
+	NULL,
+};
+
+static const struct attribute_group dma_auto_group = {
+	.attrs = dma_auto_attrs,
+};
+
+/**********************/
+/******** INIT ********/
+/**********************/
+int dma_auto_init(struct plng_dma_device *dma_dev)
+{
+	struct device *dev = &dma_dev->pdev->dev;
+	int ret;
+
+	dma_dev->auto_pio_max = DMA_AUTO_PIO_MAX;
+	dma_dev->auto_pg_min = DMA_AUTO_PG_MIN;
+	mutex_init(&dma_dev->cal_lock);
+
+	ret = devm_device_add_group(dev, &dma_auto_group);
+	if (ret) {
+		dev_err(dev, "devm_device_add_group() failure\n");
+		return ret;
+	}
+
+	/* debugfs is optional, errors are not fatal */
+	debugfs_create_file("calibrate", 0600, dma_dev->dbg_dir, dma_dev,
+			    &calibrate_fops);
+	return 0;
+}
@@ -0,0 +1,21 @@
+/**
+ * @file:	dma_auto.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_AUTO_H)
+#define DMA_AUTO_H
+
+#include <linux/types.h>
+#include "plng_dma_device.h"
+
+unsigned long dma_auto_mode(struct plng_dma_ctx *ctx,
+			    const void __user *buf,
+			    size_t count);
+
+int dma_auto_calibrate(struct plng_dma_device *dma_dev);
+
+int dma_auto_init(struct plng_dma_device *dma_dev);
+
+#endif /* !defined(DMA_AUTO_H) */
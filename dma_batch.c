@@ -0,0 +1,277 @@
+/**
+ * @file:	dma_batch.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/scatterlist.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+
+#include "dma.h"
+#include "dma_pg.h"
+#include "dma_batch.h"
+#include "khack.h"
+#include "log.h"
+
+struct batch_ent {
+	struct dmadrv_xfer xfer;
+	usrbuf_t *usrbuf;	/* pinned user buffer, NULL for IOBUF alias */
+	dma_addr_t daddr;	/* IOBUF alias */
+	int nsegs;		/* 0 if entry was rejected */
+};
+
+static inline enum dma_data_direction batch_map_dir(struct batch_ent *ent)
+{
+	return ent->xfer.dir == XFER_READ ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+}
+
+static inline enum dma_transfer_direction batch_dir(struct batch_ent *ent)
+{
+	return ent->xfer.dir == XFER_READ ? DMA_DEV_TO_MEM : DMA_MEM_TO_DEV;
+}
+
+/* Returns number of chain segments entry takes or -errno */
+static int batch_get_ent(struct plng_dma_ctx *ctx,
+			 struct batch_ent *ent)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dmadrv_xfer *x = &ent->xfer;
+	void __user *addr = u64_to_user_ptr(x->addr);
+
+	if (x->dir >= INVALID_XFER || !x->len || x->len > INT_MAX)
+		return -EINVAL;
+	if (x->br_offset >= dma_dev->base_size)
+		return -EINVAL;
+	if (ctx->fifo_mode == INCR_ADDR &&
+	    x->len > dma_dev->base_size - x->br_offset)
+		return -EINVAL;
+
+	ent->daddr = dma_translate_buf(ctx, addr, x->len);
+	if (ent->daddr)
+		return 1;
+
+	/* first pinned entry gets the arena, the rest allocate */
+	ent->usrbuf = get_usr_buf(dma_dev, ctx->pg_arena, addr, x->len,
+				  batch_map_dir(ent));
+	if (!ent->usrbuf)
+		return -EFAULT;
+	return ent->usrbuf->sgnum;
+}
+
+static void batch_put_ent(struct plng_dma_device *dma_dev,
+			  struct batch_ent *ent)
+{
+	if (ent->usrbuf)
+		put_usr_buf(dma_dev, ent->usrbuf);
+	ent->usrbuf = NULL;
+}
+
+static void batch_set_seg(struct plng_dma_ctx *ctx,
+			  struct batch_ent *ent,
+			  struct scatterlist *sg,
+			  struct dma_drv_seg *seg,
+			  dma_addr_t mem, dma_addr_t br,
+			  unsigned int len)
+{
+	int fifo = ctx->fifo_mode == FIFO_ADDR;
+	/* ACP only snoops cacheable requests, pinned pages never go there */
+	enum pl330_cachectrl cctl =
+		!ent->usrbuf && ctx->coherency == ACP_IOBUF ? CCTRL7 : CCTRL0;
+
+	sg->length = len;
+	sg_dma_address(sg) = mem;
+	sg_dma_len(sg) = len;
+
+	if (ent->xfer.dir == XFER_READ) {
+		seg->src = br;
+		seg->dst = mem;
+		seg->src_inc = !fifo;
+		seg->dst_inc = 1;
+		seg->scctl = CCTRL0;
+		seg->dcctl = cctl;
+	} else {
+		seg->src = mem;
+		seg->dst = br;
+		seg->src_inc = 1;
+		seg->dst_inc = !fifo;
+		seg->scctl = cctl;
+		seg->dcctl = CCTRL0;
+	}
+}
+
+/* Returns number of segments filled */
+static int batch_fill_segs(struct plng_dma_ctx *ctx,
+			   struct batch_ent *ent,
+			   struct scatterlist *sg,
+			   struct dma_drv_seg *seg)
+{
+	dma_addr_t br = ctx->dma_dev->dma_base + ent->xfer.br_offset;
+	struct scatterlist *usg;
+	int i;
+
+	if (!ent->usrbuf) {
+		dma_buf_sync_dev(ctx, ent->daddr, ent->xfer.len,
+				 batch_dir(ent));
+		batch_set_seg(ctx, ent, sg, seg,
+			      ent->daddr, br, ent->xfer.len);
+		return 1;
+	}
+
+	for_each_sg(ent->usrbuf->sgs, usg, ent->usrbuf->sgnum, i) {
+		unsigned int len = sg_dma_len(usg);
+
+		batch_set_seg(ctx, ent, sg + i, seg + i,
+			      sg_dma_address(usg), br, len);
+		if (ctx->fifo_mode == INCR_ADDR)
+			br += len;
+	}
+	return i;
+}
+
+static int batch_run(struct plng_dma_ctx *ctx,
+		     struct batch_ent *ents, u32 count, int nsegs)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct device *dev = &dma_dev->pdev->dev;
+	struct dma_async_tx_descriptor *desc;
+	struct dma_slave_config conf;
+	struct dma_drv_seg *segs;
+	struct scatterlist *sgs;
+	int ret, seg = 0;
+	u32 i;
+
+	segs = kmalloc_array(nsegs, sizeof(*segs), GFP_KERNEL);
+	if (!segs)
+		return -ENOMEM;
+
+	sgs = kmalloc_array(nsegs, sizeof(*sgs), GFP_KERNEL);
+	if (!sgs) {
+		ret = -ENOMEM;
+		goto FREE_SEGS;
+	}
+
+	sg_init_table(sgs, nsegs);
+	for (i = 0; i != count; i++) {
+		if (ents[i].nsegs)
+			seg += batch_fill_segs(ctx, &ents[i],
+					       sgs + seg, segs + seg);
+	}
+
+	/* Addresses are patched per request below, config only
+	 * sets widths and bursts for the whole chain */
+	memzero_explicit(&conf, sizeof(struct dma_slave_config));
+	conf.direction = DMA_DEV_TO_MEM;
+	conf.src_addr = (phys_addr_t)dma_dev->dma_base;
+	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.src_maxburst = 16;
+	conf.dst_maxburst = 16;
+
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		goto FREE_SGS;
+
+	if (dmaengine_slave_config(dma_dev->dmach, &conf) < 0) {
+		dev_err(dev, "dmaengine_slave_config() failure\n");
+		ret = -EIO;
+		goto CHAN_PUT;
+	}
+
+	desc = dmaengine_prep_slave_sg(dma_dev->dmach,
+				       sgs,
+				       nsegs,
+				       DMA_DEV_TO_MEM,
+				       DMA_PREP_INTERRUPT);
+	if (IS_ERR_OR_NULL(desc)) {
+		dev_err(dev, "dmaengine_prep_slave_sg() failure\n");
+		ret = -EIO;
+		goto CHAN_PUT;
+	}
+
+	dma_drv_hack_chdir(desc);
+	dma_drv_hack_setsegs(desc, segs);
+
+	/* IOBUF aliases are synced around the chain, pinned buffers by
+	 * dma map/unmap; callback is set on the last request only */
+	ret = dma_submit_and_wait(dma_dev, desc, NULL);
+	goto FREE_SGS;
+
+CHAN_PUT:
+	dma_chan_put(dma_dev);
+FREE_SGS:
+	kfree(sgs);
+FREE_SEGS:
+	kfree(segs);
+	return ret;
+}
+
+/**********************/
+/******* BATCH ********/
+/**********************/
+long dma_batch(struct plng_dma_ctx *ctx,
+	       struct dmadrv_batch __user *ubatch)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dmadrv_batch batch;
+	struct dmadrv_xfer __user *uxfers;
+	struct batch_ent *ents;
+	int ret, nsegs = 0;
+	long done = 0;
+	u32 i;
+
+	if (copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+	if (!batch.count || batch.count > DMADRV_BATCH_MAX || batch.flags)
+		return -EINVAL;
+	uxfers = u64_to_user_ptr(batch.xfers);
+
+	ents = kcalloc(batch.count, sizeof(*ents), GFP_KERNEL);
+	if (!ents)
+		return -ENOMEM;
+
+	for (i = 0; i != batch.count; i++) {
+		if (copy_from_user(&ents[i].xfer, &uxfers[i],
+				   sizeof(ents[i].xfer))) {
+			done = -EFAULT;
+			goto PUT_ENTS;
+		}
+		ret = batch_get_ent(ctx, &ents[i]);
+		if (ret < 0) {
+			ents[i].xfer.status = ret;
+			continue;
+		}
+		ents[i].nsegs = ret;
+		nsegs += ret;
+	}
+
+	ret = nsegs ? batch_run(ctx, ents, batch.count, nsegs) : 0;
+
+	for (i = 0; i != batch.count; i++) {
+		if (!ents[i].nsegs)
+			continue;
+		if (!ents[i].usrbuf)
+			dma_buf_sync_cpu(ctx, ents[i].daddr, ents[i].xfer.len,
+					 batch_dir(&ents[i]));
+		ents[i].xfer.status = ret;
+		if (!ret)
+			++done;
+	}
+
+PUT_ENTS:
+	for (i = 0; i != batch.count; i++) {
+		batch_put_ent(dma_dev, &ents[i]);
+		if (done >= 0 &&
+		    put_user(ents[i].xfer.status, &uxfers[i].status))
+			done = -EFAULT;
+	}
+	kfree(ents);
+	return done;
+}
@@ -0,0 +1,16 @@
+/**
+ * @file:	dma_batch.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_BATCH_H)
+#define DMA_BATCH_H
+
+#include <linux/types.h>
+#include "plng_dma_device.h"
+
+long dma_batch(struct plng_dma_ctx *ctx,
+	       struct dmadrv_batch __user *ubatch);
+
+#endif /* !defined(DMA_BATCH_H) */
@@ -0,0 +1,261 @@
+/**
+ * @file:	dma_cyclic.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/gfp.h>
+#include <linux/log2.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+
+#include "dma.h"
+#include "dma_cyclic.h"
+#include "khack.h"
+#include "log.h"
+
+/* ring page is user writable, geometry and prod are kept here */
+static inline size_t ring_off(struct plng_dma_ctx *ctx, u32 period)
+{
+	return (size_t)(period & (ctx->cyclic_nperiods - 1)) *
+		ctx->cyclic_period_len;
+}
+
+/* Called from the PL330 tasklet once per completed period */
+static void cyclic_callback(void *param)
+{
+	struct plng_dma_ctx *ctx = param;
+	struct dmadrv_ring *ring = ctx->ring;
+	u32 prod = ctx->cyclic_prod;
+
+	dma_buf_sync_cpu(ctx, ctx->dma_buf + ring_off(ctx, prod),
+			 ctx->cyclic_period_len, DMA_DEV_TO_MEM);
+
+	/* DMA moves on to the slot of period prod + 1 - nperiods */
+	++prod;
+	if (prod - READ_ONCE(ring->cons) >= ctx->cyclic_nperiods)
+		WRITE_ONCE(ring->overruns, ring->overruns + 1);
+
+	ctx->cyclic_prod = prod;
+	smp_wmb();
+	WRITE_ONCE(ring->prod, prod);
+	wake_up_interruptible(&ctx->ring_wait);
+}
+
+/**********************/
+/******** RING ********/
+/**********************/
+/* Header page is allocated on first use and kept until release */
+struct dmadrv_ring *dma_cyclic_ring(struct plng_dma_ctx *ctx)
+{
+	mutex_lock(&ctx->lock);
+	if (!ctx->ring)
+		ctx->ring = (struct dmadrv_ring *)get_zeroed_page(GFP_KERNEL);
+	mutex_unlock(&ctx->lock);
+	return ctx->ring;
+}
+
+void dma_cyclic_fini(struct plng_dma_ctx *ctx)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+
+	if (READ_ONCE(dma_dev->cyclic_ctx) == ctx)
+		dma_cyclic_stop(ctx);
+	free_page((unsigned long)ctx->ring);
+	ctx->ring = NULL;
+}
+
+/**********************/
+/******* START ********/
+/**********************/
+long dma_cyclic_start(struct plng_dma_ctx *ctx,
+		      struct dmadrv_cyclic __user *ucyc)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct device *dev = &dma_dev->pdev->dev;
+	struct dma_async_tx_descriptor *desc;
+	struct dma_slave_config conf;
+	struct dmadrv_cyclic cyc;
+	struct dmadrv_ring *ring;
+	dma_cookie_t cookie;
+	long ret;
+
+	if (copy_from_user(&cyc, ucyc, sizeof(cyc)))
+		return -EFAULT;
+	if (cyc.nperiods < 2 || !is_power_of_2(cyc.nperiods) ||
+	    ctx->buf_size / cyc.nperiods < PAGE_SIZE || cyc.flags)
+		return -EINVAL;
+	if (cyc.br_offset >= dma_dev->base_size)
+		return -EINVAL;
+
+	ring = dma_cyclic_ring(ctx);
+	if (!ring)
+		return -ENOMEM;
+
+	mutex_lock(&ctx->lock);
+	ret = dma_buf_alloc(ctx);
+	mutex_unlock(&ctx->lock);
+	if (ret)
+		return ret;
+
+	/* one capture per device, needs the channel to itself */
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		return ret;
+	if (!dma_chan_idle(dma_dev)) {
+		ret = -EBUSY;
+		goto CHAN_PUT;
+	}
+
+	ctx->cyclic_nperiods = cyc.nperiods;
+	ctx->cyclic_period_len = ctx->buf_size / cyc.nperiods;
+	ctx->cyclic_prod = 0;
+
+	memset(ring, 0, PAGE_SIZE);
+	ring->nperiods = ctx->cyclic_nperiods;
+	ring->period_len = ctx->cyclic_period_len;
+
+	memzero_explicit(&conf, sizeof(struct dma_slave_config));
+	conf.direction = DMA_DEV_TO_MEM;
+	conf.src_addr = (phys_addr_t)(dma_dev->dma_base + cyc.br_offset);
+	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.src_maxburst = 16;
+	conf.dst_maxburst = 16;
+
+	if (dmaengine_slave_config(dma_dev->dmach, &conf) < 0) {
+		dev_err(dev, "dmaengine_slave_config() failure\n");
+		ret = -EINVAL;
+		goto CHAN_PUT;
+	}
+
+	desc = dmaengine_prep_dma_cyclic(dma_dev->dmach,
+					 ctx->dma_buf,
+					 ctx->buf_size,
+					 ctx->cyclic_period_len,
+					 DMA_DEV_TO_MEM,
+					 DMA_PREP_INTERRUPT);
+	if (IS_ERR_OR_NULL(desc)) {
+		dev_err(dev, "dmaengine_prep_dma_cyclic() failure\n");
+		ret = -EIO;
+		goto CHAN_PUT;
+	}
+
+	dma_drv_hack_chdir(desc);
+	dma_drv_hack_setfifo(desc, DMA_DEV_TO_MEM);
+	dma_buf_hack_cache(ctx, desc, DMA_DEV_TO_MEM);
+	dma_buf_sync_dev(ctx, ctx->dma_buf, ctx->buf_size, DMA_DEV_TO_MEM);
+
+	/* pl330 copies these to every period on submit */
+	desc->callback = cyclic_callback;
+	desc->callback_param = ctx;
+
+	cookie = dma_chan_submit(dma_dev, desc);
+	if (dma_submit_error(cookie)) {
+		dmaengine_terminate_sync(dma_dev->dmach);
+		dma_drv_hack_mkcyclic(dma_dev->dmach, 0);
+		ret = -EIO;
+		goto CHAN_PUT;
+	}
+
+	ctx->cyclic_prev_mode = ctx->dma_mode;
+	ctx->dma_mode = CYCLIC_OPMODE;
+	WRITE_ONCE(dma_dev->cyclic_ctx, ctx);
+
+CHAN_PUT:
+	dma_chan_put(dma_dev);
+	return ret;
+}
+
+/**********************/
+/******** STOP ********/
+/**********************/
+long dma_cyclic_stop(struct plng_dma_ctx *ctx)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+
+	mutex_lock(&dma_dev->chan_lock);
+	if (dma_dev->cyclic_ctx != ctx) {
+		mutex_unlock(&dma_dev->chan_lock);
+		return -EINVAL;
+	}
+
+	dmaengine_terminate_sync(dma_dev->dmach);
+	/* pl330 keeps the channel cyclic until it is freed */
+	dma_drv_hack_mkcyclic(dma_dev->dmach, 0);
+
+	ctx->dma_mode = ctx->cyclic_prev_mode;
+	WRITE_ONCE(dma_dev->cyclic_ctx, NULL);
+	mutex_unlock(&dma_dev->chan_lock);
+
+	wake_up_interruptible(&ctx->ring_wait);
+	return 0;
+}
+
+/**********************/
+/******** READ ********/
+/**********************/
+/* Copies out whole periods, blocks until at least one is ready */
+ssize_t dma_read_cyclic(struct plng_dma_ctx *ctx,
+			void __user * dst,
+			const loff_t br_offset,
+			size_t count)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dmadrv_ring *ring = ctx->ring;
+	size_t plen = ctx->cyclic_period_len;
+	u32 nper = ctx->cyclic_nperiods;
+	size_t done = 0;
+	u32 prod, cons;
+
+	/* capture belongs to the file that started it */
+	if (READ_ONCE(dma_dev->cyclic_ctx) != ctx)
+		return -EBUSY;
+	if (count < plen)
+		return -EINVAL;
+
+	if (wait_event_interruptible(ctx->ring_wait,
+				     READ_ONCE(ctx->cyclic_prod) !=
+				     READ_ONCE(ring->cons) ||
+				     READ_ONCE(dma_dev->cyclic_ctx) != ctx))
+		return -ERESTARTSYS;
+
+	prod = READ_ONCE(ctx->cyclic_prod);
+	smp_rmb();
+	cons = READ_ONCE(ring->cons);
+
+	/* skip periods already overwritten or being written */
+	if (prod - cons > nper - 1)
+		cons = prod - (nper - 1);
+
+	while (cons != prod && count - done >= plen) {
+		if (copy_to_user(dst + done,
+				 ctx->buf + ring_off(ctx, cons),
+				 plen))
+			return -EFAULT;
+		done += plen;
+		++cons;
+	}
+
+	WRITE_ONCE(ring->cons, cons);
+	return done;
+}
+
+/**********************/
+/******* WRITE ********/
+/**********************/
+ssize_t dma_write_cyclic(struct plng_dma_ctx *ctx,
+			 const void __user * src,
+			 loff_t br_offset,
+			 size_t count)
+{
+	/* capture only, channel is owned by the running transfer */
+	return -EBUSY;
+}
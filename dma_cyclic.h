@@ -0,0 +1,30 @@
+/**
+ * @file:	dma_cyclic.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_CYCLIC_H)
+#define DMA_CYCLIC_H
+
+#include <linux/types.h>
+#include "plng_dma_device.h"
+
+struct dmadrv_ring *dma_cyclic_ring(struct plng_dma_ctx *ctx);
+void dma_cyclic_fini(struct plng_dma_ctx *ctx);
+
+long dma_cyclic_start(struct plng_dma_ctx *ctx,
+		      struct dmadrv_cyclic __user *ucyc);
+long dma_cyclic_stop(struct plng_dma_ctx *ctx);
+
+ssize_t dma_read_cyclic(struct plng_dma_ctx *ctx,
+			void __user * dst,
+			const loff_t br_offset,
+			size_t count);
+
+ssize_t dma_write_cyclic(struct plng_dma_ctx *ctx,
+			 const void __user * src,
+			 loff_t br_offset,
+			 size_t count);
+
+#endif /* !defined(DMA_CYCLIC_H) */
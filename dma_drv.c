@@ -9,6 +9,8 @@
 #include <linux/of.h>
 
 #include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/ioport.h>
 
@@ -19,6 +21,8 @@
 #include <linux/wait.h>
 
 #include <linux/fs.h>
+#include <linux/uio.h>
+#include <linux/debugfs.h>
 #include <linux/miscdevice.h>
 #include <linux/platform_device.h>
 
@@ -26,16 +30,29 @@
 #include "rlsctl.h"
 #include "dma.h"
 #include "dma_pg.h"
+#include "dma_aio.h"
+#include "dma_batch.h"
+#include "dma_reg.h"
+#include "dma_cyclic.h"
+#include "dma_slot.h"
+#include "dma_xfer.h"
+#include "dma_auto.h"
+#include "dma_poll.h"
+#include "dma_stat.h"
+#include "dma_sim.h"
+
+#define CREATE_TRACE_POINTS
+#include "dma_trace.h"
 #include "iomemcpy.h"
 #include "log.h"
 
 
-typedef ssize_t (*wr_func_t)(struct plng_dma_device *dma_dev,
+typedef ssize_t (*wr_func_t)(struct plng_dma_ctx *ctx,
 			     const void __user *src,
 			     loff_t br_offset,
 			     size_t count);
 
-typedef ssize_t (*rd_func_t)(struct plng_dma_device *dma_dev,
+typedef ssize_t (*rd_func_t)(struct plng_dma_ctx *ctx,
 			     void __user * dst,
 			     const loff_t br_offset,
 			     size_t count);
@@ -55,83 +72,248 @@ struct op {
 	struct wr_op wrop;
 };
 
+static inline
+struct plng_dma_ctx *file_to_dma_ctx(struct file *file)
+{
+	return file->private_data;
+}
+
 static inline
 struct plng_dma_device *file_to_dma_dev(struct file *file)
 {
-	struct miscdevice *misc = file->private_data;
-	return container_of(misc, struct plng_dma_device, mdev);
+	return file_to_dma_ctx(file)->dma_dev;
 }
 
-static void dma_callback(void *completion)
+static void dma_callback(void *param)
 {
-	pr_info("Hello from callback\n");
-	complete(completion);
+	struct dma_wait *wait = param;
+
+	wait->irq_ns = ktime_get_ns();
+	if (wait->ts)
+		trace_dma_drv_callback(wait->ts);
+	complete(&wait->done);
 	return;
 }
 
-ssize_t dumb_read(struct plng_dma_device *dma_dev,
+/**********************/
+/********* PIO ********/
+/**********************/
+/* Leading part of a PIO copy done in NEON bursts, the rest by words */
+static inline size_t pio_neon_len(bool neon, size_t len)
+{
+	return neon ? round_down(len, IOMEMCPY_NEON_BLOCK) : 0;
+}
+
+static void bridge_pio_read(struct plng_dma_device *dma_dev, void *dst,
+			    loff_t br_offset, size_t len, unsigned long fifo)
+{
+	void __iomem *src = dma_dev->base + br_offset;
+	size_t n;
+
+	if (fifo == FIFO_ADDR) {
+		n = pio_neon_len(dma_dev->pio_neon_fifo, len);
+		if (n && !iomemcpy_neon_from_fifo(dst, src, n))
+			n = 0;
+		iomemcpy32_from_fifo(dst + n, src, len - n);
+	} else if (fifo == INCR_ADDR) {
+		n = pio_neon_len(dma_dev->pio_neon, len);
+		if (n && !iomemcpy_neon_fromio(dst, src, n))
+			n = 0;
+		memcpy_fromio(dst + n, src + n, len - n);
+	}
+}
+
+static void bridge_pio_write(struct plng_dma_device *dma_dev,
+			     const void *src, loff_t br_offset, size_t len,
+			     unsigned long fifo)
+{
+	void __iomem *dst = dma_dev->base + br_offset;
+	size_t n;
+
+	if (fifo == FIFO_ADDR) {
+		n = pio_neon_len(dma_dev->pio_neon_fifo, len);
+		if (n && !iomemcpy_neon_to_fifo(dst, src, n))
+			n = 0;
+		iomemcpy32_to_fifo(dst, src + n, len - n);
+	} else if (fifo == INCR_ADDR) {
+		n = pio_neon_len(dma_dev->pio_neon, len);
+		if (n && !iomemcpy_neon_toio(dst, src, n))
+			n = 0;
+		memcpy_toio(dst + n, src + n, len - n);
+	}
+}
+
+static const struct dma_pio_ops bridge_pio_ops = {
+	.read = bridge_pio_read,
+	.write = bridge_pio_write,
+};
+
+/* Bridge offset of the chunk at off into a PIO transfer */
+static inline loff_t pio_br_offset(struct plng_dma_ctx *ctx,
+				   loff_t br_offset, size_t off)
+{
+	return ctx->fifo_mode == FIFO_ADDR ? br_offset : br_offset + off;
+}
+
+/* Kernel address of a word aligned buf within ctx's IOBUF mapping */
+static void *pio_alias(struct plng_dma_ctx *ctx, const void __user *buf,
+		       size_t len)
+{
+	dma_addr_t daddr;
+
+	if (((unsigned long)buf | len) & 3)
+		return NULL;
+	daddr = dma_translate_buf(ctx, buf, len);
+	return daddr ? ctx->buf + (daddr - ctx->dma_buf) : NULL;
+}
+
+/*
+ * Moves DMA_PIO_CHUNK at a time through pio_buf, so the staging copy
+ * stays in cache. An IOBUF alias is copied to directly.
+ */
+ssize_t dumb_read(struct plng_dma_ctx *ctx,
 		  void __user * dst,
 		  const loff_t br_offset,
 		  size_t len)
 {
-	if (dma_dev->fifo_mode == FIFO_ADDR) {
-		iomemcpy32_from_fifo(dma_dev->buf,
-				     dma_dev->base + br_offset,
-				     len);
-	} else if (dma_dev->fifo_mode == INCR_ADDR) {
-		memcpy_fromio(dma_dev->buf,
-			      dma_dev->base + br_offset,
-			      len);
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_stat_ts ts = {
+		.br_offset = br_offset,
+		.mode = DUMB_OPMODE,
+		.fifo = ctx->fifo_mode,
+		.dir = DMA_DEV_TO_MEM,
+	};
+	u64 t0 = dma_stat_now(&ts);
+	size_t off, chunk;
+	ssize_t ret;
+	void *kbuf;
+
+	ts.len = len;
+	trace_dma_drv_submit(&ts);
+	kbuf = pio_alias(ctx, dst, len);
+
+	mutex_lock(&dma_dev->pio_lock);
+	if (kbuf) {
+		dma_dev->pio->read(dma_dev, kbuf, br_offset, len,
+				   ctx->fifo_mode);
+		ret = len;
+		goto UNLOCK;
+	}
+
+	for (off = 0; off != len; off += chunk) {
+		chunk = min_t(size_t, len - off, DMA_PIO_CHUNK);
+		dma_dev->pio->read(dma_dev, dma_dev->pio_buf,
+				   pio_br_offset(ctx, br_offset, off), chunk,
+				   ctx->fifo_mode);
+		if (0L != copy_to_user(dst + off, dma_dev->pio_buf, chunk))
+			break;
 	}
+	ret = (off || !len) ? (ssize_t)off : -EFAULT;
+
+UNLOCK:
+	mutex_unlock(&dma_dev->pio_lock);
 
-	if (0L != copy_to_user(dst, dma_dev->buf, len))
-		return (-EFAULT);
-	return (ssize_t)len;
+	dma_stat_add(&ts, DMA_STAT_TOTAL, t0);
+	dma_stat_account(dma_dev, &ts);
+	trace_dma_drv_released(&ts);
+	return ret;
 }
 
-ssize_t dumb_write(struct plng_dma_device *dma_dev,
+ssize_t dumb_write(struct plng_dma_ctx *ctx,
 		   const void __user *src,
 		   loff_t br_offset,
 		   size_t len)
 {
-	if (0L != copy_from_user(dma_dev->buf,
-				 src,
-				 len))
-		return (-EFAULT);
-
-	if (dma_dev->fifo_mode == FIFO_ADDR) {
-		iomemcpy32_to_fifo(dma_dev->base + br_offset,
-				   src,
-				   len);
-	} else if (dma_dev->fifo_mode == INCR_ADDR) {
-		memcpy_toio(dma_dev->base + br_offset,
-			    src,
-			    len);
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_stat_ts ts = {
+		.br_offset = br_offset,
+		.mode = DUMB_OPMODE,
+		.fifo = ctx->fifo_mode,
+		.dir = DMA_MEM_TO_DEV,
+	};
+	u64 t0 = dma_stat_now(&ts);
+	size_t off, chunk;
+	ssize_t ret;
+	void *kbuf;
+
+	ts.len = len;
+	trace_dma_drv_submit(&ts);
+	kbuf = pio_alias(ctx, src, len);
+
+	mutex_lock(&dma_dev->pio_lock);
+	if (kbuf) {
+		dma_dev->pio->write(dma_dev, kbuf, br_offset, len,
+				    ctx->fifo_mode);
+		ret = len;
+		goto UNLOCK;
 	}
-	return len;
-}
 
-static int offset_error(loff_t off, size_t len)
-{
-	if (off) {
-		printk(KERN_ERR "Offset not supported!\n");
-		return 1;
+	for (off = 0; off != len; off += chunk) {
+		chunk = min_t(size_t, len - off, DMA_PIO_CHUNK);
+		if (0L != copy_from_user(dma_dev->pio_buf, src + off, chunk))
+			break;
+		dma_dev->pio->write(dma_dev, dma_dev->pio_buf,
+				    pio_br_offset(ctx, br_offset, off), chunk,
+				    ctx->fifo_mode);
 	}
+	ret = (off || !len) ? (ssize_t)off : -EFAULT;
+
+UNLOCK:
+	mutex_unlock(&dma_dev->pio_lock);
+
+	dma_stat_add(&ts, DMA_STAT_TOTAL, t0);
+	dma_stat_account(dma_dev, &ts);
+	trace_dma_drv_released(&ts);
+	return ret;
+}
+
 /*
-	if (regions_tab[bridge].size < len) {
-		printk(KERN_ERR "Len greater than ioreg!\n");
+ * The file offset is the bridge offset. It must be word aligned and
+ * inside the window; INCR_ADDR transfers are cut at its end, a FIFO
+ * needs one word there.
+ */
+static int offset_error(struct plng_dma_ctx *ctx, loff_t off, size_t *len)
+{
+	loff_t size = ctx->dma_dev->base_size;
+
+	if (off < 0 || (off & 3) || off >= size)
 		return 1;
-	}
-*/
+	if (ctx->fifo_mode == FIFO_ADDR)
+		return size - off < 4;
+	*len = min_t(loff_t, *len, size - off);
 	return 0;
 }
 
+static ssize_t auto_read(struct plng_dma_ctx *ctx, void __user *dst,
+			 const loff_t br_offset, size_t len);
+static ssize_t auto_write(struct plng_dma_ctx *ctx, const void __user *src,
+			  loff_t br_offset, size_t len);
+
 static struct op ops[] = {
 	{{&dumb_read, "DUMB_READ"}, {&dumb_write, "DUMB_WRITE"}},
 	{{&dma_read, "DMA_READ"}, {&dma_write, "DMA_WRITE"}},
-	{{&dma_read_pg, "DMAPG_READ"}, {&dma_write_pg, "DMAPG_WRITE"}}
+	{{&dma_read_pg, "DMAPG_READ"}, {&dma_write_pg, "DMAPG_WRITE"}},
+	{{&dma_read_cyclic, "CYCLIC_READ"}, {&dma_write_cyclic, "CYCLIC_WRITE"}},
+	{{&auto_read, "AUTO_READ"}, {&auto_write, "AUTO_WRITE"}}
 };
 
+/* AUTO_OPMODE: one of the first three ops, picked per transfer */
+static ssize_t auto_read(struct plng_dma_ctx *ctx, void __user *dst,
+			 const loff_t br_offset, size_t len)
+{
+	unsigned long mode = dma_auto_mode(ctx, dst, len);
+
+	return ops[mode].rdop.rdfunc(ctx, dst, br_offset, len);
+}
+
+static ssize_t auto_write(struct plng_dma_ctx *ctx, const void __user *src,
+			  loff_t br_offset, size_t len)
+{
+	unsigned long mode = dma_auto_mode(ctx, src, len);
+
+	return ops[mode].wrop.wrfunc(ctx, src, br_offset, len);
+}
+
 /**********************/
 /******** READ ********/
 /**********************/
@@ -139,15 +321,13 @@ static ssize_t
 dma_drv_read(struct file *fp, char __user *dst, size_t len,
 	     loff_t *off)
 {
-	struct plng_dma_device * dma_dev = file_to_dma_dev(fp);
-	struct device *dev = &dma_dev->pdev->dev;
-	struct rd_op *rdop = &ops[dma_dev->dma_mode].rdop;
-	dev_info(dev, "op: %s, len = %d\n", rdop->name, len);
+	struct plng_dma_ctx *ctx = file_to_dma_ctx(fp);
+	struct rd_op *rdop = &ops[ctx->dma_mode].rdop;
 
-	if (dma_dev->fifo_mode != FIFO_ADDR && offset_error(*off, len))
+	if (offset_error(ctx, *off, &len))
 		return (-EINVAL);
 
-	return rdop->rdfunc(dma_dev, dst, *off, len);
+	return rdop->rdfunc(ctx, dst, *off, len);
 }
 
 /**********************/
@@ -157,15 +337,72 @@ static ssize_t
 dma_drv_write(struct file *fp, const char __user *src, size_t len,
 	      loff_t *off)
 {
-	struct plng_dma_device * dma_dev = file_to_dma_dev(fp);
-	struct device *dev = &dma_dev->pdev->dev;
-	struct wr_op *wrop = &ops[dma_dev->dma_mode].wrop;
-	dev_info(dev, "op: %s, len = %d\n", wrop->name, len);
+	struct plng_dma_ctx *ctx = file_to_dma_ctx(fp);
+	struct wr_op *wrop = &ops[ctx->dma_mode].wrop;
 
-	if (dma_dev->fifo_mode != FIFO_ADDR && offset_error(*off, len))
+	if (offset_error(ctx, *off, &len))
 		return (-EINVAL);
 
-	return wrop->wrfunc(dma_dev, src, *off, len);
+	return wrop->wrfunc(ctx, src, *off, len);
+}
+
+/**********************/
+/******** IOVEC *******/
+/**********************/
+/*
+ * readv()/writev() and aio/io_uring. DMAPG runs every segment in one
+ * sg chain, queued without waiting for async kiocbs. Other modes take
+ * the segments one op call each and complete inline. In INCR_ADDR
+ * mode the bridge offset moves along the segments as if they were one
+ * buffer.
+ */
+static ssize_t
+dma_drv_xfer_iter(struct kiocb *iocb, struct iov_iter *iter, bool write)
+{
+	struct plng_dma_ctx *ctx = file_to_dma_ctx(iocb->ki_filp);
+	struct op *op = &ops[ctx->dma_mode];
+	size_t len = iov_iter_count(iter);
+	ssize_t ret, done = 0;
+	struct iovec iov;
+	loff_t off;
+
+	if (offset_error(ctx, iocb->ki_pos, &len))
+		return (-EINVAL);
+	iov_iter_truncate(iter, len);
+
+	if (ctx->dma_mode == DMAPG_OPMODE && !is_sync_kiocb(iocb))
+		return dma_aio_xfer(ctx, iocb, iter,
+				    write ? DMA_MEM_TO_DEV : DMA_DEV_TO_MEM);
+	if (ctx->dma_mode == DMAPG_OPMODE)
+		return dma_xfer_pg_iter(ctx, iter, iocb->ki_pos,
+					write ? DMA_MEM_TO_DEV : DMA_DEV_TO_MEM);
+	if (!iter_is_iovec(iter))
+		return (-EINVAL);
+
+	while (iov_iter_count(iter)) {
+		iov = iov_iter_iovec(iter);
+		off = iocb->ki_pos + (ctx->fifo_mode == FIFO_ADDR ? 0 : done);
+		ret = write ?
+			op->wrop.wrfunc(ctx, iov.iov_base, off, iov.iov_len) :
+			op->rdop.rdfunc(ctx, iov.iov_base, off, iov.iov_len);
+		if (ret <= 0)
+			return done ? done : ret;
+		iov_iter_advance(iter, ret);
+		done += ret;
+		if (ret != iov.iov_len)
+			break;
+	}
+	return done;
+}
+
+static ssize_t dma_drv_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	return dma_drv_xfer_iter(iocb, to, false);
+}
+
+static ssize_t dma_drv_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	return dma_drv_xfer_iter(iocb, from, true);
 }
 
 /**********************/
@@ -178,21 +415,97 @@ dma_drv_ioctl(struct file *filp, unsigned int cmd,
 	long retval = 0L;
 	unsigned dir = _IOC_DIR(cmd);
 
-	struct plng_dma_device * dma_dev = file_to_dma_dev(filp);
+	struct plng_dma_ctx *ctx = file_to_dma_ctx(filp);
+	struct plng_dma_device * dma_dev = ctx->dma_dev;
 
 	switch (_IOC_NR(cmd)) {
 	case OPMODE:
 		if (dir == _IOC_READ)
-			retval = dma_dev->dma_mode;
+			retval = ctx->dma_mode;
+		else if (ctx->dma_mode == CYCLIC_OPMODE)
+			retval = -EBUSY;
+		else if (arg == CYCLIC_OPMODE || arg >= INVALID_OPMODE)
+			retval = -EINVAL;
 		else
-		        dma_dev->dma_mode = arg;
+		        ctx->dma_mode = arg;
 		
 		break;
 	case INCRADDR:
 		if (dir == _IOC_READ)
-			retval = dma_dev->fifo_mode;
+			retval = ctx->fifo_mode;
 		else
-		        dma_dev->fifo_mode = arg;
+		        ctx->fifo_mode = arg;
+		break;
+	case BATCH:
+		retval = dma_batch(ctx, (struct dmadrv_batch __user *)arg);
+		break;
+	case SGNUM:
+		retval = ctx->last_sgnum;
+		break;
+	case REGBUF:
+		retval = dma_reg_register(ctx,
+					  (struct dmadrv_regbuf __user *)arg);
+		break;
+	case UNREGBUF:
+		retval = dma_reg_unregister(ctx, arg);
+		break;
+	case CYCLIC:
+		retval = dma_cyclic_start(ctx,
+					  (struct dmadrv_cyclic __user *)arg);
+		break;
+	case CYCLICSTOP:
+		retval = dma_cyclic_stop(ctx);
+		break;
+	case SLOTS:
+		if (dir == _IOC_READ)
+			retval = ctx->nslots;
+		else
+			retval = dma_slot_setup(ctx, arg);
+		break;
+	case SLOTSUBMIT:
+		retval = dma_slot_submit(ctx,
+					 (struct dmadrv_slot __user *)arg);
+		break;
+	case SLOTWAIT:
+		retval = dma_slot_wait(ctx, arg);
+		break;
+	case STRIPES:
+		if (dir == _IOC_READ)
+			retval = ctx->stripes;
+		else if (!arg || arg > dma_dev->nchans)
+			retval = -EINVAL;
+		else
+			ctx->stripes = arg;
+		break;
+	case BUFSIZE:
+		if (dir == _IOC_READ)
+			retval = ctx->buf_size;
+		else
+			retval = dma_buf_set_size(ctx, arg);
+		break;
+	case COHERENCY:
+		if (dir == _IOC_READ)
+			retval = ctx->coherency;
+		else
+			retval = dma_buf_set_coherency(ctx, arg);
+		break;
+	case XFERNEW:
+		retval = dma_xfer_create(ctx,
+					 (struct dmadrv_xferobj __user *)arg);
+		break;
+	case XFERRUN:
+		retval = dma_xfer_launch(ctx, arg);
+		break;
+	case XFERDEL:
+		retval = dma_xfer_destroy(ctx, arg);
+		break;
+	case SYNCCPU:
+		retval = dma_buf_sync(ctx, (struct dmadrv_sync __user *)arg,
+				      true);
+		break;
+	case SYNCDEV:
+		retval = dma_buf_sync(ctx, (struct dmadrv_sync __user *)arg,
+				      false);
 		break;
 	default:
 		return (-ENOTTY);
@@ -205,49 +518,94 @@ dma_drv_ioctl(struct file *filp, unsigned int cmd,
 /**********************/
 int dma_drv_mmap (struct file *filp, struct vm_area_struct *vma)
 {
-	struct plng_dma_device * dma_dev = file_to_dma_dev(filp);
-	return  dma_mmap(dma_dev, filp, vma);
+	return  dma_mmap(file_to_dma_ctx(filp), filp, vma);
+}
+
+/**********************/
+/******** SEEK ********/
+/**********************/
+/*
+ * Selects the bridge offset for read()/write(), which do not move it:
+ * each call addresses the same region until the next seek.
+ */
+static loff_t dma_drv_llseek(struct file *filp, loff_t off, int whence)
+{
+	struct plng_dma_ctx *ctx = file_to_dma_ctx(filp);
+
+	return fixed_size_llseek(filp, off, whence, ctx->dma_dev->base_size);
+}
+
+/**********************/
+/******** OPEN ********/
+/**********************/
+static int dma_drv_open(struct inode *inode, struct file *filp)
+{
+	struct miscdevice *misc = filp->private_data;
+	struct plng_dma_ctx *ctx;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->dma_dev = container_of(misc, struct plng_dma_device, mdev);
+	ctx->buf_size = IOBUF_SIZE;
+	ctx->dma_mode = DUMB_OPMODE;
+	ctx->fifo_mode = FIFO_ADDR;
+	ctx->stripes = ctx->dma_dev->stripes;
+	ctx->pg_arena = dma_pg_arena_alloc();
+	if (!ctx->pg_arena) {
+		kfree(ctx);
+		return -ENOMEM;
+	}
+	mutex_init(&ctx->lock);
+	mutex_init(&ctx->reg_lock);
+	init_waitqueue_head(&ctx->reg_wait);
+	init_waitqueue_head(&ctx->ring_wait);
+
+	filp->private_data = ctx;
+	return 0;
+}
+
+/* Last reference is dropped after every mmap of the file is gone */
+static int dma_drv_release(struct inode *inode, struct file *filp)
+{
+	struct plng_dma_ctx *ctx = file_to_dma_ctx(filp);
+
+	dma_cyclic_fini(ctx);
+	dma_slot_fini(ctx);
+	dma_xfer_fini(ctx);
+	dma_reg_fini(ctx);
+	dma_buf_free(ctx);
+	dma_pg_arena_free(ctx->pg_arena);
+	mutex_destroy(&ctx->reg_lock);
+	mutex_destroy(&ctx->lock);
+	kfree(ctx);
+	return 0;
 }
 
 static struct file_operations dma_drv_fops = {
 	.owner = THIS_MODULE,
-	.llseek = no_llseek,
+	.llseek = dma_drv_llseek,
 	.read = dma_drv_read,
 	.write = dma_drv_write,
+	.read_iter = dma_drv_read_iter,
+	.write_iter = dma_drv_write_iter,
 	.unlocked_ioctl = dma_drv_ioctl,
 	.mmap = dma_drv_mmap,
-	.open = nonseekable_open,
+	.open = dma_drv_open,
+	.release = dma_drv_release,
 };
 
 /**********************/
 /******** INIT ********/
 /**********************/
-static int dma_drv_anal_probe(struct platform_device *pdev)
+/* Bridge window from the DT node */
+static int dma_drv_map_bridge(struct plng_dma_device *dma_dev)
 {
-	int ret;
-
-	struct plng_dma_device *dma_dev;
+	struct platform_device *pdev = dma_dev->pdev;
 	struct device *dev = &pdev->dev;
 	struct resource *res;
-
-	dev_info(dev, "HELLO\n");
-	dma_dev = devm_kzalloc(dev, sizeof(*dma_dev), GFP_KERNEL);
-	if (IS_ERR(dma_dev)) {
-		dev_err(dev, "devm_kzalloc fail");
-		return -ENOMEM;
-	}
-
-#ifdef CONFIG_DMA_ENGINE
-	dev_info(dev, "DMA ENGINE ON");
-#else
-	dev_info(dev, "DMA ENGINE OFF");
-#endif
-
-	dma_dev->buf = (void*)devm_get_free_pages(dev, GFP_KERNEL, get_order(IOBUF_SIZE));
-	if (IS_ERR(dma_dev->buf)) {
-		dev_err(dev, "get_free_pages fail");
-		return -ENOMEM;
-	}
+	u32 bus_width = 32, fifo_span = 4;
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (IS_ERR(res)) {
@@ -268,20 +626,86 @@ static int dma_drv_anal_probe(struct platform_device *pdev)
 		dev_err(dev, "devm_request_mem_region fail");
 		return -ENOMEM;
 	}
+	dma_dev->base_phys = res->start;
 	dma_dev->base_size = resource_size(res);
+	dma_dev->pio = &bridge_pio_ops;
+
+	/*
+	 * NEON bursts need a 64 bit bridge. FIFO ones also need the FIFO
+	 * to decode a whole burst worth of addresses.
+	 */
+	of_property_read_u32(dev->of_node, "plng,bus-width", &bus_width);
+	of_property_read_u32(dev->of_node, "plng,fifo-span", &fifo_span);
+	dma_dev->pio_neon = bus_width >= 64;
+	dma_dev->pio_neon_fifo = dma_dev->pio_neon &&
+		fifo_span >= IOMEMCPY_NEON_BLOCK;
+	dev_info(dev, "PIO %u bit, NEON %s, FIFO NEON %s\n", bus_width,
+		 dma_dev->pio_neon ? "on" : "off",
+		 dma_dev->pio_neon_fifo ? "on" : "off");
+	return 0;
+}
+
+static int dma_drv_anal_probe(struct platform_device *pdev)
+{
+	int ret;
+
+	struct plng_dma_device *dma_dev;
+	struct device *dev = &pdev->dev;
+
+	dev_info(dev, "HELLO\n");
+	dma_dev = devm_kzalloc(dev, sizeof(*dma_dev), GFP_KERNEL);
+	if (IS_ERR(dma_dev)) {
+		dev_err(dev, "devm_kzalloc fail");
+		return -ENOMEM;
+	}
+
+#ifdef CONFIG_DMA_ENGINE
+	dev_info(dev, "DMA ENGINE ON");
+#else
+	dev_info(dev, "DMA ENGINE OFF");
+#endif
 
-	dma_dev->dma_mode = DUMB_OPMODE;
-	dma_dev->fifo_mode = FIFO_ADDR;
 	dma_dev->pdev = pdev;
+	if (dma_sim_client(pdev))
+		ret = dma_sim_attach(dma_dev);
+	else
+		ret = dma_drv_map_bridge(dma_dev);
+	if (ret)
+		return ret;
+
 	dma_dev->dma_callback = &dma_callback;
+	mutex_init(&dma_dev->chan_lock);
+	dma_aio_init(dma_dev);
+	mutex_init(&dma_dev->pio_lock);
+
+	/* IOBUFs are per open, this only stages DUMB_OPMODE chunks */
+	dma_dev->pio_buf = kvmalloc(DMA_PIO_CHUNK, GFP_KERNEL);
+	if (!dma_dev->pio_buf) {
+		dev_err(dev, "kvmalloc fail");
+		return -ENOMEM;
+	}
 
 	/* must be done before dma_init */
 	platform_set_drvdata(pdev, dma_dev);
 
 	if ((ret = dma_init(dma_dev)) != 0) {
 		dev_err(dev, "dma_init fail");
-		return ret;
+		goto FREE_PIO_BUF;
+	}
+
+	dma_dev->dbg_dir = debugfs_create_dir(dev_name(dev), NULL);
+
+	ret = dma_auto_init(dma_dev);
+	if (ret) {
+		dev_err(dev, "dma_auto_init fail");
+		goto DMA_FINI;
+	}
+	ret = dma_poll_init(dma_dev);
+	if (ret) {
+		dev_err(dev, "dma_poll_init fail");
+		goto DMA_FINI;
 	}
+	dma_stat_init(dma_dev);
 
 	dma_dev->mdev.minor  = MISC_DYNAMIC_MINOR;
 	dma_dev->mdev.name   = "dma_miscdev";
@@ -298,7 +722,10 @@ static int dma_drv_anal_probe(struct platform_device *pdev)
 	return 0;
 
 DMA_FINI:
+	debugfs_remove_recursive(dma_dev->dbg_dir);
 	dma_fini(dma_dev);
+FREE_PIO_BUF:
+	kvfree(dma_dev->pio_buf);
 	return ret;
 }
 
@@ -309,7 +736,9 @@ static int dma_drv_anal_remove(struct platform_device *pdev)
 {
 	struct plng_dma_device *dma_dev = platform_get_drvdata(pdev);
 	misc_deregister(&dma_dev->mdev);
+	debugfs_remove_recursive(dma_dev->dbg_dir);
 	dma_fini(dma_dev);
+	kvfree(dma_dev->pio_buf);
 	return 0;
 }
 
@@ -330,7 +759,29 @@ static struct platform_driver dma_drv_driver = {
 	},
 };
 
-module_platform_driver(dma_drv_driver);
+static int __init dma_drv_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&dma_drv_driver);
+	if (ret)
+		return ret;
+
+	/* no-op unless loaded with sim=1 */
+	ret = dma_sim_init();
+	if (ret)
+		platform_driver_unregister(&dma_drv_driver);
+	return ret;
+}
+
+static void __exit dma_drv_exit(void)
+{
+	dma_sim_fini();
+	platform_driver_unregister(&dma_drv_driver);
+}
+
+module_init(dma_drv_init);
+module_exit(dma_drv_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Doroshenko K");
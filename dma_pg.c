@@ -10,30 +10,28 @@
 #include <linux/errno.h>
 
 #include <linux/mm.h>
+#include <linux/uio.h>
 #include <linux/scatterlist.h>
 #include <linux/page-flags.h>
 #include <linux/pagemap.h>
 #include <linux/slab.h>
+#include <linux/completion.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
 #include <asm/current.h>
 
 #include "iomemcpy.h"
+#include "dma.h"
 #include "dma_pg.h"
+#include "dma_reg.h"
+#include "dma_stripe.h"
+#include "dma_stat.h"
+#include "dma_trace.h"
 #include "khack.h"
 #include "log.h"
 
-#define MAX_PAGES_NUM		(64UL)
-
-#define DMA_MAP_SG_DUMB /*DUMB!*/
-
-#ifdef DMA_MAP_SG_DUMB
-#define dma_drv_map_sg		dma_map_sg_dumb
-#define dma_drv_unmap_sg	dma_unmap_sg_dumb
-#else
-#define dma_drv_map_sg		dma_map_sg_attrs
-#define dma_drv_unmap_sg	dma_unmap_sg
-#endif
+/* pipelined transfers are cut into chunks one arena slot can pin */
+#define DMA_PG_CHUNK		(DMA_PG_ARENA_PAGES * PAGE_SIZE)
 
 #define DMA_DRV_DEV_BURST_LEN	(16)
 #define DMA_DRV_MEM_BURST_LEN	(16)
@@ -44,20 +42,6 @@
 #define DMA_DRV_READ_MAP_DIR 	DMA_FROM_DEVICE
 #define DMA_DRV_WRITE_MAP_DIR 	DMA_TO_DEVICE
 
-typedef struct {
-	void __user *vaddr;
-	void *kaddr;
-	dma_addr_t daddr;
-	size_t len;
-	size_t off1st;
-	size_t llast;
-	size_t pgnum;
-	size_t sgnum;
-	struct page **pages;
-	struct scatterlist *sgs;
-	enum dma_data_direction dir;
-} usrbuf_t;
-
 static size_t
 calc_pgs_num(usrbuf_t *usrbuf)
 {
@@ -80,161 +64,326 @@ calc_pgs_num(usrbuf_t *usrbuf)
 	return usrbuf->pgnum;
 }
 
-static void
-populate_sgs(usrbuf_t *usrbuf)
+/*
+ * Physically adjacent pages are merged into one sg entry
+ * of at most max_seg bytes. Returns number of entries used.
+ * usrbuf->sgs may be chained, it is only walked with sg_next().
+ */
+static size_t
+populate_sgs(usrbuf_t *usrbuf, unsigned int max_seg)
 {
-	size_t i, len = usrbuf->len;
+	struct scatterlist *sg = usrbuf->sgs;
+	size_t i, nents = 1, len = usrbuf->len;
 	size_t sglen = min((size_t)(PAGE_SIZE - usrbuf->off1st), len);
 
-	sg_init_table(usrbuf->sgs, usrbuf->pgnum);
-
 	/* 1st page definitely has nonzero off */
-	sg_set_page(usrbuf->sgs, usrbuf->pages[0], sglen, usrbuf->off1st);
+	sg_set_page(sg, usrbuf->pages[0], sglen, usrbuf->off1st);
 	len -= sglen;
-	/* iterate remaining sg */
+	/* iterate remaining pages */
 	for (i = 1; i < usrbuf->pgnum; i++) {
 		sglen = min((size_t)PAGE_SIZE, len);
-		sg_set_page(usrbuf->sgs + i, usrbuf->pages[i], sglen, 0);
+		if (page_to_pfn(usrbuf->pages[i]) ==
+		    page_to_pfn(usrbuf->pages[i - 1]) + 1 &&
+		    sg->length + sglen <= max_seg) {
+			sg->length += sglen;
+		} else {
+			sg = sg_next(sg);
+			sg_set_page(sg, usrbuf->pages[i], sglen, 0);
+			++nents;
+		}
 		len -= sglen;
 	}
+	sg_mark_end(sg);
+	usrbuf->sg_last = sg;
+	return nents;
 }
 
-static int
-dma_map_sg_dumb(struct device *dev, struct scatterlist *sg,
-		int nents, enum dma_data_direction dir,
-		unsigned long attrs)
+/**********************/
+/******** ARENA *******/
+/**********************/
+/* Per slot: ARENA_PAGES pages array and a chained sg table */
+struct dma_pg_arena *dma_pg_arena_alloc(void)
 {
+	struct dma_pg_arena *arena;
+	usrbuf_t *usrbuf;
 	int i;
-	for (i = 0; i != nents; i++) {
-		sg[i].dma_address = dma_map_page(dev,
-						 (struct page *)sg[i].page_link,
-						 sg[i].offset,
-						 sg[i].length, dir);
-		if (dma_mapping_error(dev, sg[i].dma_address)) {
-			goto ROLL_BACK;
-		}
+
+	arena = kzalloc(sizeof(*arena), GFP_KERNEL);
+	if (!arena)
+		return NULL;
+	for (i = 0; i != DMA_PG_ARENA_SLOTS; i++) {
+		usrbuf = &arena->usrbuf[i];
+		usrbuf->arena = arena;
+		usrbuf->pages = kvmalloc_array(DMA_PG_ARENA_PAGES,
+					       sizeof(struct page *),
+					       GFP_KERNEL);
+		if (!usrbuf->pages)
+			goto FREE_ARENA;
+		if (sg_alloc_table(&usrbuf->sgt, DMA_PG_ARENA_PAGES,
+				   GFP_KERNEL))
+			goto FREE_ARENA;
+		usrbuf->sgs = usrbuf->sgt.sgl;
+		arena->sg_end[i] = sg_last(usrbuf->sgs, DMA_PG_ARENA_PAGES);
 	}
-	return nents;
-ROLL_BACK:
-	printk(KERN_ERR
-	       "dma_map_sg_dumb() fail, i=%d, &p=%px, o=%d, l=%d\n",
-	       i, (struct page *)sg[i].page_link, sg[i].offset,
-	       sg[i].length);
-	if (--i > 0) {
-		for (; i >= 0; i--) {
-			dma_unmap_page(dev,
-				       sg[i].dma_address, sg[i].length, dir);
-		}
+	return arena;
+
+FREE_ARENA:
+	dma_pg_arena_free(arena);
+	return NULL;
+}
+
+void dma_pg_arena_free(struct dma_pg_arena *arena)
+{
+	int i;
+
+	if (!arena)
+		return;
+	for (i = 0; i != DMA_PG_ARENA_SLOTS; i++) {
+		if (arena->usrbuf[i].sgs)
+			sg_free_table(&arena->usrbuf[i].sgt);
+		kvfree(arena->usrbuf[i].pages);
 	}
-	return 0;
+	kfree(arena);
 }
 
-static void
-dma_unmap_sg_dumb(struct device *dev, struct scatterlist *sg,
-		  int nents, enum dma_data_direction dir)
+/*
+ * Bookkeeping for up to pgmax pages: a free arena slot if it is big
+ * enough, otherwise allocated here. Never called under mmap_sem.
+ */
+static usrbuf_t *usrbuf_get(struct dma_pg_arena *arena, size_t pgmax)
 {
+	usrbuf_t *usrbuf;
 	int i;
-	for (i = 0; i != nents; i++) {
-		dma_unmap_page(dev, sg[i].dma_address, sg[i].length, dir);
+
+	for (i = 0; arena && pgmax <= DMA_PG_ARENA_PAGES &&
+	     i != DMA_PG_ARENA_SLOTS; i++) {
+		if (test_and_set_bit_lock(i, &arena->busy))
+			continue;
+		usrbuf = &arena->usrbuf[i];
+		usrbuf->pgnum = 0;
+		usrbuf->nents = 0;
+		usrbuf->sgnum = 0;
+		usrbuf->sg_last = NULL;
+		return usrbuf;
 	}
+
+	usrbuf = kzalloc(sizeof(usrbuf_t), GFP_KERNEL);
+	if (!usrbuf)
+		return NULL;
+	usrbuf->pages = kvmalloc_array(pgmax, sizeof(struct page *),
+				       GFP_KERNEL);
+	if (!usrbuf->pages)
+		goto FREE_USR_BUF;
+	/* chained past one page worth of entries */
+	if (sg_alloc_table(&usrbuf->sgt, pgmax, GFP_KERNEL))
+		goto FREE_PAGES;
+	usrbuf->sgs = usrbuf->sgt.sgl;
+	return usrbuf;
+
+FREE_PAGES:
+	kvfree(usrbuf->pages);
+FREE_USR_BUF:
+	kfree(usrbuf);
+	return NULL;
 }
 
-static usrbuf_t *get_usr_buf(struct plng_dma_device *dma_dev,
-			     void __user * buf, size_t len,
-			     enum dma_data_direction dir)
+static void usrbuf_put(usrbuf_t *usrbuf)
+{
+	struct dma_pg_arena *arena = usrbuf->arena;
+
+	int i;
+
+	if (arena) {
+		i = usrbuf - arena->usrbuf;
+		/* next user fills the table from the start again */
+		if (usrbuf->sg_last && usrbuf->sg_last != arena->sg_end[i])
+			sg_unmark_end(usrbuf->sg_last);
+		clear_bit_unlock(i, &arena->busy);
+		return;
+	}
+	sg_free_table(&usrbuf->sgt);
+	kvfree(usrbuf->pages);
+	kfree(usrbuf);
+}
+
+/**********************/
+/******** PIN *********/
+/**********************/
+usrbuf_t *get_usr_buf(struct plng_dma_device *dma_dev,
+		      struct dma_pg_arena *arena,
+		      void __user * buf, size_t len,
+		      enum dma_data_direction dir)
 {
 	size_t pgnum;
+	long pinned;
 	size_t i;
 	struct device *dev = &dma_dev->pdev->dev;
-/* ALLOC_USR_BUF */
-	usrbuf_t *usrbuf = kmalloc(sizeof(usrbuf_t), GFP_KERNEL);
+	struct device *dmadev = dma_dev->dmach->device->dev;
+	usrbuf_t *usrbuf;
+
+	if (!len)
+		return NULL;
+
+/* GET USR BUF */
+	pgnum = DIV_ROUND_UP(((size_t)buf & (PAGE_SIZE - 1)) + len, PAGE_SIZE);
+	usrbuf = usrbuf_get(arena, pgnum);
 	if (NULL == usrbuf) {
-		printk(KERN_ERR "kmalloc() usrbuf_t error!\n");
+		dev_err(dev, "usrbuf_get() error!\n");
 		return NULL;
 	}
 	// calculate number of pages in user buf
 	usrbuf->vaddr = buf;
 	usrbuf->len = len;
 	usrbuf->dir = dir;
-	pgnum = calc_pgs_num(usrbuf);
-
-/* ALLOC PAGES */
-	usrbuf->pages = kmalloc(pgnum * sizeof(struct page *), GFP_KERNEL);
-	if (NULL == usrbuf->pages) {
-		dev_err(dev, "kmalloc() pages error!\n");
-		goto FREE_USR_BUF;
-	}
+	calc_pgs_num(usrbuf);
 
 /* SEM DOWN */
 	down_read(&current->mm->mmap_sem);
 
 /* GET PAGES */
-	pgnum = get_user_pages((unsigned long)buf,
+	pinned = get_user_pages((unsigned long)buf,
 				pgnum,
 				FOLL_WRITE,
 				usrbuf->pages,
 				NULL);
-	if (!pgnum) {
+
+/* SEM UP */
+	up_read(&current->mm->mmap_sem);
+
+	if (pinned <= 0) {
 	        dev_err(dev, "get_user_pages() error!\n");
-		goto SEM_UP;
+		usrbuf->pgnum = 0;
+		goto PUT_USR_BUF;
 	}
 
-	usrbuf->pgnum = pgnum;
-
-/* ALLOC SGS */
-	usrbuf->sgs = kmalloc(pgnum * sizeof(struct scatterlist), GFP_KERNEL);
-	if (NULL == usrbuf->sgs) {
-	        dev_err(dev, "kmalloc() sgs error!\n");
+	usrbuf->pgnum = pinned;
+	if (pinned != pgnum) {
+	        dev_err(dev, "get_user_pages() short!\n");
 		goto PUT_PAGES;
 	}
 
-	populate_sgs(usrbuf);
+	usrbuf->nents = populate_sgs(usrbuf, dma_get_max_seg_size(dmadev));
 
 /* DMA MAP SG */
-	usrbuf->sgnum = dma_drv_map_sg(dma_dev->dmach->device->dev,
-				       usrbuf->sgs,
-				       usrbuf->pgnum,
-				       usrbuf->dir,
-				       0);
+	usrbuf->sgnum = dma_map_sg_attrs(dmadev,
+					 usrbuf->sgs,
+					 usrbuf->nents,
+					 usrbuf->dir,
+					 0);
 
 	if (usrbuf->sgnum == 0) {
 	        dev_err(dev, "dma_map_sg() error!\n");
-		goto FREE_SGS;
+		goto PUT_PAGES;
 	}
-	up_read(&current->mm->mmap_sem);
 	return usrbuf;
 
-FREE_SGS:			/* !ALLOC SGS */
-	kfree(usrbuf->sgs);
 PUT_PAGES:			/* !GET PAGES */
 	for (i = 0; i < usrbuf->pgnum; ++i)
 		put_page(usrbuf->pages[i]);
-SEM_UP:			/* !SEM DOWN */
-	up_read(&current->mm->mmap_sem);
-/* FREE_PAGES:				!ALLOC PAGES */
-	kfree(usrbuf->pages);
-FREE_USR_BUF:			/* !ALLOC_USR_BUF */
-	kfree(usrbuf);
+PUT_USR_BUF:			/* !GET USR BUF */
+	usrbuf_put(usrbuf);
 	return 0;
 }
 
-static void put_usr_buf(struct plng_dma_device *dma_dev, usrbuf_t * usrbuf)
+void put_usr_buf(struct plng_dma_device *dma_dev, usrbuf_t * usrbuf)
 {
 	size_t i;
 /* UNMAP_SG:					 !DMA MAP SG */
-	dma_drv_unmap_sg(dma_dev->dmach->device->dev,
-			 usrbuf->sgs,
-			 usrbuf->sgnum,
-			 usrbuf->dir);
-/* FREE_SGS:					 !ALLOC SGS */
-	kfree(usrbuf->sgs);
+	dma_unmap_sg(dma_dev->dmach->device->dev,
+		     usrbuf->sgs,
+		     usrbuf->nents,
+		     usrbuf->dir);
 /* PUT_PAGES:				   !GET PAGES */
 	for (i = 0; i < usrbuf->pgnum; ++i)
 		put_page(usrbuf->pages[i]);
-/* FREE_PAGES:				!ALLOC PAGES */
-	kfree(usrbuf->pages);
-/* FREE_USR_BUF:			!ALLOC_USR_BUF */
-	kfree(usrbuf);
+/* PUT_USR_BUF:			!GET USR BUF */
+	usrbuf_put(usrbuf);
+}
+
+/*
+ * Appends one pinned page run to the sg list, merging it into the
+ * last entry when both are physically adjacent across a page end.
+ */
+static void
+append_sgs(usrbuf_t *usrbuf, struct page **pages, size_t off,
+	   size_t len, unsigned int max_seg)
+{
+	struct scatterlist *sg = usrbuf->sg_last;
+	size_t sglen;
+
+	for (; len; pages++, len -= sglen, off = 0) {
+		sglen = min((size_t)PAGE_SIZE - off, len);
+		if (sg && !off && !((sg->offset + sg->length) & ~PAGE_MASK) &&
+		    page_to_pfn(pages[0]) ==
+		    page_to_pfn(usrbuf->pages[usrbuf->pgnum - 1]) + 1 &&
+		    sg->length + sglen <= max_seg) {
+			sg->length += sglen;
+		} else {
+			sg = sg ? sg_next(sg) : usrbuf->sgs;
+			sg_set_page(sg, pages[0], sglen, off);
+			usrbuf->nents++;
+		}
+		usrbuf->pgnum++;
+	}
+	usrbuf->sg_last = sg;
+}
+
+/*
+ * get_usr_buf() over every segment of iter: all of them pinned into
+ * one sg list, mapped once. Consumes iter.
+ */
+usrbuf_t *get_usr_iter(struct plng_dma_device *dma_dev,
+		       struct dma_pg_arena *arena,
+		       struct iov_iter *iter,
+		       enum dma_data_direction dir)
+{
+	struct device *dev = &dma_dev->pdev->dev;
+	struct device *dmadev = dma_dev->dmach->device->dev;
+	unsigned int max_seg = dma_get_max_seg_size(dmadev);
+	size_t i, off, pgmax;
+	ssize_t bytes;
+	usrbuf_t *usrbuf;
+
+	if (!iov_iter_count(iter))
+		return NULL;
+	pgmax = iov_iter_npages(iter, INT_MAX);
+	usrbuf = usrbuf_get(arena, pgmax);
+	if (!usrbuf) {
+		dev_err(dev, "usrbuf_get() failure\n");
+		return NULL;
+	}
+	usrbuf->vaddr = NULL;
+	usrbuf->len = iov_iter_count(iter);
+	usrbuf->dir = dir;
+
+	/* one segment, or what is left of it, per call */
+	while (iov_iter_count(iter)) {
+		bytes = iov_iter_get_pages(iter, usrbuf->pages + usrbuf->pgnum,
+					   iov_iter_count(iter),
+					   pgmax - usrbuf->pgnum, &off);
+		if (bytes <= 0) {
+			dev_err(dev, "iov_iter_get_pages() failure\n");
+			goto PUT_PAGES;
+		}
+		iov_iter_advance(iter, bytes);
+		append_sgs(usrbuf, usrbuf->pages + usrbuf->pgnum, off, bytes,
+			   max_seg);
+	}
+	sg_mark_end(usrbuf->sg_last);
+
+	usrbuf->sgnum = dma_map_sg_attrs(dmadev, usrbuf->sgs, usrbuf->nents,
+					 usrbuf->dir, 0);
+	if (!usrbuf->sgnum) {
+		dev_err(dev, "dma_map_sg() failure\n");
+		goto PUT_PAGES;
+	}
+	return usrbuf;
+
+PUT_PAGES:
+	for (i = 0; i < usrbuf->pgnum; ++i)
+		put_page(usrbuf->pages[i]);
+	usrbuf_put(usrbuf);
+	return NULL;
 }
 
 void print_pg(const void *pg_data)
@@ -245,9 +394,9 @@ void print_pg(const void *pg_data)
 
 void print_sg(usrbuf_t * usrbuf)
 {
+	struct scatterlist *sg;
 	size_t i;
-	for (i = 0; i != usrbuf->sgnum; i++) {
-		struct scatterlist *sg = &usrbuf->sgs[i];
+	for_each_sg(usrbuf->sgs, sg, usrbuf->sgnum, i) {
 		dma_addr_t daddr = sg_dma_address(sg);
 		unsigned int len = sg_dma_len(sg);
 		printk(KERN_INFO "daddr = %px, len = %u, offset = %u\n",
@@ -255,175 +404,354 @@ void print_sg(usrbuf_t * usrbuf)
 	}
 }
 
-/**********************/
-/******** READ ********/
-/**********************/
-ssize_t dma_read_pg(struct plng_dma_device *dma_dev,
-		    void __user * dst,
-		    const loff_t br_offset,
-		    size_t count)
+/*
+ * One slave_sg chain over already mapped sgs, not submitted yet.
+ * chan_lock held on success, released on failure.
+ */
+struct dma_async_tx_descriptor *
+dma_pg_prep_sg(struct plng_dma_ctx *ctx,
+	       struct scatterlist *sgs,
+	       unsigned int sgnum,
+	       loff_t br_offset,
+	       enum dma_transfer_direction dir,
+	       struct dma_stat_ts *ts)
 {
-	ssize_t ret = -1;
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
 	struct device *dev = &dma_dev->pdev->dev;
 	struct dma_async_tx_descriptor *desc;
 	struct dma_slave_config conf;
-	dma_cookie_t cookie;
-	usrbuf_t *usrbuf;
-
-/* GET USR BUF */
-	usrbuf = get_usr_buf(dma_dev,
-			     (void __user *)dst,
-			     count,
-			     DMA_DRV_READ_MAP_DIR);
-	if (!usrbuf) {
-		dev_err(dev, "get_usr_buf() error!");
-		return -ENOENT;
-	}
-
-	dev_info(dev, "Num sg entries = %u", usrbuf->sgnum);
-	/* print_sg(usrbuf); */
+	int ret;
+	u64 t;
 
 	memzero_explicit(&conf, sizeof(struct dma_slave_config));
-	conf.direction = DMA_DRV_READ_DIR;
-	conf.src_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
+	conf.direction = dir;
+	if (dir == DMA_DRV_READ_DIR) {
+		conf.src_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
+		conf.src_maxburst = DMA_DRV_DEV_BURST_LEN;
+		conf.dst_maxburst = DMA_DRV_MEM_BURST_LEN;
+	} else {
+		conf.dst_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
+		conf.src_maxburst = DMA_DRV_MEM_BURST_LEN;
+		conf.dst_maxburst = DMA_DRV_DEV_BURST_LEN;
+	}
 	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
 	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-	conf.src_maxburst = DMA_DRV_DEV_BURST_LEN;
-	conf.dst_maxburst = DMA_DRV_MEM_BURST_LEN;
 
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		return ERR_PTR(ret);
+
+	t = dma_stat_now(ts);
 	if (dmaengine_slave_config(dma_dev->dmach, &conf) < 0) {
-		dev_err(dev, "dmaengine_slave_config() failure");
-		ret = -EIO;
-		goto PUT_USR_BUF;
+		dev_err(dev, "dmaengine_slave_config() failure\n");
+		goto CHAN_PUT;
 	}
+	t = dma_stat_add(ts, DMA_STAT_CONFIG, t);
 
 	desc = dmaengine_prep_slave_sg(dma_dev->dmach,
-				       usrbuf->sgs,
-				       usrbuf->sgnum,
-				       DMA_DRV_READ_DIR, DMA_INTERRUPT);
-
-/*
-  desc = dmaengine_prep_dma_memcpy(dmach,
-                                   usrbuf->sgs[0].dma_address,
-                                   src,
-                                   usrbuf->sgs[0].length,
-                                   DMA_INTERRUPT);
-*/
-	if (IS_ERR(desc)) {
+				       sgs,
+				       sgnum,
+				       dir, DMA_PREP_INTERRUPT);
+	if (IS_ERR_OR_NULL(desc)) {
 		dev_err(dev, "dmaengine_prep_slave_sg() failure\n");
-		ret = -EIO;
-		goto PUT_USR_BUF;
+		goto CHAN_PUT;
 	}
 
 	dma_drv_hack_chdir(desc);
+	dma_stat_add(ts, DMA_STAT_PREP, t);
+	return desc;
 
-	init_completion(&dma_dev->transfer_ok);
-	desc->callback = dma_dev->dma_callback;
-	desc->callback_param = &dma_dev->transfer_ok;
-	cookie = dmaengine_submit(desc);
-
-	if (0 != dma_submit_error(cookie)) {
-		dev_err(dev, "dma_submit() failure\n");
-		ret = -EIO;
-		goto PUT_USR_BUF;
-	}
-
-	dma_async_issue_pending(dma_dev->dmach);
-	dev_info(dev, "Start waiting...\n");
+CHAN_PUT:
+	dma_chan_put(dma_dev);
+	return ERR_PTR(-EIO);
+}
 
-	wait_for_completion(&dma_dev->transfer_ok);
+/* Run one slave_sg chain, or stripes of it, over already mapped sgs */
+int dma_pg_xfer_sg(struct plng_dma_ctx *ctx,
+		   struct scatterlist *sgs,
+		   unsigned int sgnum,
+		   size_t count,
+		   loff_t br_offset,
+		   enum dma_transfer_direction dir,
+		   struct dma_stat_ts *ts)
+{
+	struct dma_async_tx_descriptor *desc;
+	unsigned nstripes;
 
-	ret = count;
+	nstripes = dma_stripe_count(ctx, count);
+	if (nstripes > 1)
+		return dma_stripe_xfer(ctx->dma_dev, nstripes, sgs, sgnum,
+				       count, br_offset, dir);
 
-PUT_USR_BUF:			/* !GET USR BUF */
-	put_usr_buf(dma_dev, usrbuf);
+	desc = dma_pg_prep_sg(ctx, sgs, sgnum, br_offset, dir, ts);
+	if (IS_ERR(desc))
+		return PTR_ERR(desc);
 
-	return (ret);
+	return dma_submit_and_wait(ctx->dma_dev, desc, ts);
 }
 
 /**********************/
-/******* WRITE ********/
+/******** CHUNK *******/
 /**********************/
-ssize_t dma_write_pg(struct plng_dma_device * dma_dev,
-		     const void __user * src,
-		     loff_t br_offset,
-		     size_t count)
+/* One chunk of a pipelined transfer, see dma_xfer_pg_chunked() */
+struct dma_pg_chunk {
+	usrbuf_t *usrbuf;		/* NULL if nothing queued */
+	size_t len;
+	dma_cookie_t cookie;
+	struct dma_wait wait;
+};
+
+/* At most one arena slot worth of pages, word multiple */
+static size_t chunk_len(void __user *buf, size_t count)
+{
+	size_t len = DMA_PG_CHUNK - ((unsigned long)buf & ~PAGE_MASK);
+
+	return min(count, round_down(len, (size_t)4));
+}
+
+/* Pin, map and queue one chunk behind whatever runs on the channel */
+static int chunk_submit(struct plng_dma_ctx *ctx,
+			struct dma_pg_chunk *ck,
+			void __user *buf,
+			size_t len,
+			loff_t br_offset,
+			enum dma_transfer_direction dir)
 {
-	ssize_t ret = -1;
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
 	struct dma_async_tx_descriptor *desc;
-	struct dma_slave_config conf;
+	usrbuf_t *usrbuf;
+
+	usrbuf = get_usr_buf(dma_dev, ctx->pg_arena, buf, len,
+			     dir == DMA_DRV_READ_DIR ?
+			     DMA_DRV_READ_MAP_DIR : DMA_DRV_WRITE_MAP_DIR);
+	if (!usrbuf)
+		return -EFAULT;
+	ctx->last_sgnum = usrbuf->sgnum;
+
+	desc = dma_pg_prep_sg(ctx, usrbuf->sgs, usrbuf->sgnum, br_offset,
+			      dir, NULL);
+	if (IS_ERR(desc)) {
+		put_usr_buf(dma_dev, usrbuf);
+		return PTR_ERR(desc);
+	}
+
+	init_completion(&ck->wait.done);
+	ck->wait.ts = NULL;
+	desc->callback = dma_dev->dma_callback;
+	desc->callback_param = &ck->wait;
+	ck->cookie = dma_chan_submit(dma_dev, desc);
+	dma_chan_put(dma_dev);
+	if (dma_submit_error(ck->cookie)) {
+		put_usr_buf(dma_dev, usrbuf);
+		return -EIO;
+	}
+	ck->usrbuf = usrbuf;
+	ck->len = len;
+	return 0;
+}
+
+/* Wait for a queued chunk and unpin it, its length added to *done */
+static int chunk_done(struct plng_dma_device *dma_dev,
+		      struct dma_pg_chunk *ck,
+		      size_t *done)
+{
+	int ret = 0;
+
+	if (!ck->usrbuf)
+		return 0;
+	wait_for_completion(&ck->wait.done);
+	if (dmaengine_tx_status(dma_dev->dmach, ck->cookie, NULL) !=
+	    DMA_COMPLETE)
+		ret = -EIO;
+	put_usr_buf(dma_dev, ck->usrbuf);
+	ck->usrbuf = NULL;
+	if (!ret && done)
+		*done += ck->len;
+	return ret;
+}
+
+/*
+ * Transfers over DMA_PG_CHUNK bytes are not pinned in one go. Chunk
+ * k+1 is pinned and queued while chunk k runs, then chunk k is waited
+ * for and unpinned: at most two chunks are pinned, each in an arena
+ * slot. Returns bytes done up to the first failed chunk, or error.
+ */
+static ssize_t dma_xfer_pg_chunked(struct plng_dma_ctx *ctx,
+				   void __user *buf,
+				   loff_t br_offset,
+				   size_t count,
+				   enum dma_transfer_direction dir)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_pg_chunk ck[2] = { };
+	size_t off, len, done = 0;
+	bool counting = true;
+	unsigned k, i;
+	int ret = 0, err;
+
+	for (off = 0, k = 0; off != count; off += len, k ^= 1) {
+		len = chunk_len(buf + off, count - off);
+		/* k-1 is still queued and counts if it completes */
+		ret = chunk_submit(ctx, &ck[k], buf + off, len, br_offset,
+				   dir);
+		if (ret)
+			break;
+		if (ctx->fifo_mode == INCR_ADDR)
+			br_offset += len;
+		/* chunk k is queued behind k-1, retire k-1 */
+		ret = chunk_done(dma_dev, &ck[k ^ 1], &done);
+		if (ret) {
+			counting = false;
+			break;
+		}
+	}
+
+	/* older one first, nothing after the first failed chunk counts */
+	for (i = 0; i != 2; i++) {
+		err = chunk_done(dma_dev, &ck[k ^ 1 ^ i],
+				 counting ? &done : NULL);
+		if (err)
+			counting = false;
+		if (!ret)
+			ret = err;
+	}
+	return done ? (ssize_t)done : ret;
+}
+
+static ssize_t dma_xfer_pg(struct plng_dma_ctx *ctx,
+			   void __user * buf,
+			   loff_t br_offset,
+			   size_t count,
+			   enum dma_transfer_direction dir)
+{
+	ssize_t ret;
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
 	struct device *dev = &dma_dev->pdev->dev;
-	dma_cookie_t cookie;
+	struct dma_stat_ts ts = {
+		.br_offset = br_offset,
+		.len = count,
+		.mode = DMAPG_OPMODE,
+		.fifo = ctx->fifo_mode,
+		.dir = dir,
+	};
+	u64 t0 = dma_stat_now(&ts);
 	usrbuf_t *usrbuf;
 
+	trace_dma_drv_submit(&ts);
+	ret = dma_reg_xfer(ctx, buf, br_offset, count, dir, &ts);
+	if (ret != -ENOENT)
+		goto ACCOUNT;
+
+	/* striped transfers already keep several channels busy */
+	if (count > DMA_PG_CHUNK && dma_stripe_count(ctx, count) == 1) {
+		ret = dma_xfer_pg_chunked(ctx, buf, br_offset, count, dir);
+		goto ACCOUNT;
+	}
+
 /* GET USR BUF */
 	usrbuf = get_usr_buf(dma_dev,
-			     (void __user *)src,
+			     ctx->pg_arena,
+			     buf,
 			     count,
-			     DMA_DRV_WRITE_MAP_DIR);
+			     dir == DMA_DRV_READ_DIR ?
+			     DMA_DRV_READ_MAP_DIR : DMA_DRV_WRITE_MAP_DIR);
 	if (!usrbuf) {
 		dev_err(dev, "get_usr_buf() error!\n");
 		return -ENOENT;
 	}
+	dma_stat_add(&ts, DMA_STAT_PIN, t0);
+	trace_dma_drv_pin_done(&ts);
+	trace_dma_drv_sg_mapped(&ts, usrbuf->sgnum);
 
-	dev_info(dev, "Num sg entries = %u\n", usrbuf->sgnum);
+	ctx->last_sgnum = usrbuf->sgnum;
 	/* print_sg(usrbuf); */
 
-	memzero_explicit(&conf, sizeof(struct dma_slave_config));
-	conf.direction = DMA_DRV_WRITE_DIR;
-	conf.dst_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
-	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-	conf.src_maxburst = DMA_DRV_MEM_BURST_LEN;
-	conf.dst_maxburst = DMA_DRV_DEV_BURST_LEN;
+	ret = dma_pg_xfer_sg(ctx, usrbuf->sgs, usrbuf->sgnum, count,
+			     br_offset, dir, &ts);
+	if (!ret)
+		ret = count;
 
-	if (dmaengine_slave_config(dma_dev->dmach, &conf) < 0) {
-		dev_err(dev, "dmaengine_slave_config() failure\n");
-		ret = -EIO;
-		goto PUT_USR_BUF;
-	}
-
-	desc = dmaengine_prep_slave_sg(dma_dev->dmach,
-				       usrbuf->sgs,
-				       usrbuf->sgnum,
-				       DMA_DRV_WRITE_DIR, DMA_INTERRUPT);
+/* PUT_USR_BUF:			   !GET USR BUF */
+	put_usr_buf(dma_dev, usrbuf);
 
-/*
-	desc = dmaengine_prep_dma_memcpy(dmach,
-					 dst,
-					 usrbuf->sgs[0].dma_address + \
-					 usrbuf->sgs[0].offset,
-					 usrbuf->sgs[0].length,
-					 DMA_INTERRUPT);
-*/
-	if (IS_ERR(desc)) {
-		dev_err(dev, "dmaengine_prep_slave_sg() failure\n");
-		ret = -EIO;
-		goto PUT_USR_BUF;
+ACCOUNT:
+	if (ret >= 0) {
+		dma_stat_add(&ts, DMA_STAT_TOTAL, t0);
+		dma_stat_account(dma_dev, &ts);
+		trace_dma_drv_released(&ts);
 	}
+	return (ret);
+}
 
-	dma_drv_hack_chdir(desc);
+/* readv()/writev(): every iovec segment in one slave_sg chain */
+ssize_t dma_xfer_pg_iter(struct plng_dma_ctx *ctx,
+			 struct iov_iter *iter,
+			 loff_t br_offset,
+			 enum dma_transfer_direction dir)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	size_t count = iov_iter_count(iter);
+	struct dma_stat_ts ts = {
+		.br_offset = br_offset,
+		.len = count,
+		.mode = DMAPG_OPMODE,
+		.fifo = ctx->fifo_mode,
+		.dir = dir,
+	};
+	u64 t0 = dma_stat_now(&ts);
+	usrbuf_t *usrbuf;
+	ssize_t ret;
 
-	init_completion(&dma_dev->transfer_ok);
-	desc->callback = dma_dev->dma_callback;
-	cookie = dmaengine_submit(desc);
+	if (!count)
+		return 0;
+	trace_dma_drv_submit(&ts);
+
+	usrbuf = get_usr_iter(dma_dev, ctx->pg_arena, iter,
+			      dir == DMA_DRV_READ_DIR ?
+			      DMA_DRV_READ_MAP_DIR : DMA_DRV_WRITE_MAP_DIR);
+	if (!usrbuf)
+		return -EFAULT;
+	dma_stat_add(&ts, DMA_STAT_PIN, t0);
+	trace_dma_drv_pin_done(&ts);
+	trace_dma_drv_sg_mapped(&ts, usrbuf->sgnum);
+
+	ctx->last_sgnum = usrbuf->sgnum;
+	ret = dma_pg_xfer_sg(ctx, usrbuf->sgs, usrbuf->sgnum, count,
+			     br_offset, dir, &ts);
+	if (!ret)
+		ret = count;
+	put_usr_buf(dma_dev, usrbuf);
 
-	if (0 != dma_submit_error(cookie)) {
-		dev_err(dev, "dma_submit_error() failure\n");
-		ret = -EIO;
-		goto PUT_USR_BUF;
+	if (ret >= 0) {
+		dma_stat_add(&ts, DMA_STAT_TOTAL, t0);
+		dma_stat_account(dma_dev, &ts);
+		trace_dma_drv_released(&ts);
 	}
+	return ret;
+}
 
-	dma_async_issue_pending(dma_dev->dmach);
-	dev_info(dev, "Start waiting...\n");
-	wait_for_completion(&dma_dev->transfer_ok);
-
-	ret = count;
-
-PUT_USR_BUF:			/* !GET USR BUF */
-	put_usr_buf(dma_dev, usrbuf);
+/**********************/
+/******** READ ********/
+/**********************/
+ssize_t dma_read_pg(struct plng_dma_ctx *ctx,
+		    void __user * dst,
+		    const loff_t br_offset,
+		    size_t count)
+{
+	return dma_xfer_pg(ctx, dst, br_offset, count,
+			   DMA_DRV_READ_DIR);
+}
 
-	return (ret);
+/**********************/
+/******* WRITE ********/
+/**********************/
+ssize_t dma_write_pg(struct plng_dma_ctx *ctx,
+		     const void __user * src,
+		     loff_t br_offset,
+		     size_t count)
+{
+	return dma_xfer_pg(ctx, (void __user *)src, br_offset, count,
+			   DMA_DRV_WRITE_DIR);
 }
 
 MODULE_LICENSE("GPL");
@@ -8,14 +8,87 @@
 #define DMA_PG_H
 
 #include <linux/types.h>
+#include <linux/scatterlist.h>
+#include <linux/dma-direction.h>
 #include "plng_dma_device.h"
 
-ssize_t dma_read_pg(struct plng_dma_device *dma_dev,
+/* pages one file can pin without allocating, larger ones allocate */
+#define DMA_PG_ARENA_PAGES	(1024UL)
+/* usrbufs per arena: chunk in flight and the one being pinned */
+#define DMA_PG_ARENA_SLOTS	(2)
+
+struct dma_stat_ts;
+struct iov_iter;
+struct dma_pg_arena;
+
+typedef struct {
+	void __user *vaddr;
+	void *kaddr;
+	dma_addr_t daddr;
+	size_t len;
+	size_t off1st;
+	size_t llast;
+	size_t pgnum;
+	size_t nents;		/* sg entries after merging */
+	size_t sgnum;		/* sg entries after dma mapping */
+	struct page **pages;
+	struct sg_table sgt;
+	struct scatterlist *sgs;	/* sgt.sgl, possibly chained */
+	struct scatterlist *sg_last;	/* last entry in use */
+	struct dma_pg_arena *arena;	/* NULL if allocated per transfer */
+	enum dma_data_direction dir;
+} usrbuf_t;
+
+/* preallocated usrbuf_t's, one user each at a time */
+struct dma_pg_arena {
+	unsigned long busy;		/* bit per slot */
+	usrbuf_t usrbuf[DMA_PG_ARENA_SLOTS];
+	/* ends marked by sg_alloc_table() */
+	struct scatterlist *sg_end[DMA_PG_ARENA_SLOTS];
+};
+
+struct dma_pg_arena *dma_pg_arena_alloc(void);
+void dma_pg_arena_free(struct dma_pg_arena *arena);
+
+usrbuf_t *get_usr_buf(struct plng_dma_device *dma_dev,
+		      struct dma_pg_arena *arena,
+		      void __user * buf, size_t len,
+		      enum dma_data_direction dir);
+
+usrbuf_t *get_usr_iter(struct plng_dma_device *dma_dev,
+		       struct dma_pg_arena *arena,
+		       struct iov_iter *iter,
+		       enum dma_data_direction dir);
+
+void put_usr_buf(struct plng_dma_device *dma_dev, usrbuf_t * usrbuf);
+
+struct dma_async_tx_descriptor *
+dma_pg_prep_sg(struct plng_dma_ctx *ctx,
+	       struct scatterlist *sgs,
+	       unsigned int sgnum,
+	       loff_t br_offset,
+	       enum dma_transfer_direction dir,
+	       struct dma_stat_ts *ts);
+
+int dma_pg_xfer_sg(struct plng_dma_ctx *ctx,
+		   struct scatterlist *sgs,
+		   unsigned int sgnum,
+		   size_t count,
+		   loff_t br_offset,
+		   enum dma_transfer_direction dir,
+		   struct dma_stat_ts *ts);
+
+ssize_t dma_xfer_pg_iter(struct plng_dma_ctx *ctx,
+			 struct iov_iter *iter,
+			 loff_t br_offset,
+			 enum dma_transfer_direction dir);
+
+ssize_t dma_read_pg(struct plng_dma_ctx *ctx,
 		    void __user * dst,
 		    const loff_t br_offset,
 		    size_t count);
 
-ssize_t dma_write_pg(struct plng_dma_device * dma_dev,
+ssize_t dma_write_pg(struct plng_dma_ctx *ctx,
 		     const void __user * src,
 		     loff_t br_offset,
 		     size_t count);
@@ -0,0 +1,154 @@
+/**
+ * @file:	dma_poll.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/log2.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/sched.h>
+#include <linux/device.h>
+#include <linux/dmaengine.h>
+
+#include "dma_poll.h"
+#include "log.h"
+
+/* not worth a timer below this */
+#define DMA_POLL_SLEEP_MIN_NS	(20000ULL)
+/* spin for at most 8 estimates, clamped, then wait for the callback */
+#define DMA_POLL_DEADLINE_MUL	(8U)
+#define DMA_POLL_DEADLINE_MIN_NS	(100000ULL)
+#define DMA_POLL_DEADLINE_MAX_NS	(2000000ULL)
+
+/**********************/
+/******** WAIT ********/
+/**********************/
+/*
+ * Spins on the cookie until the PL330 tasklet has retired it. In
+ * hybrid mode sleeps half the recent completion time of this size
+ * class first, like NVMe hybrid polling. Returns the time the
+ * transfer was seen done, or 0 once the deadline derived from the
+ * estimate passes: the caller then waits for the callback instead.
+ */
+u64 dma_poll_wait(struct plng_dma_device *dma_dev, dma_cookie_t cookie,
+		  size_t len)
+{
+	unsigned b = ilog2(len);
+	u64 t0 = ktime_get_ns(), t, est = READ_ONCE(dma_dev->poll_est_ns[b]);
+	u64 deadline = t0 + (est ? clamp(est * DMA_POLL_DEADLINE_MUL,
+					 DMA_POLL_DEADLINE_MIN_NS,
+					 DMA_POLL_DEADLINE_MAX_NS) :
+			     DMA_POLL_DEADLINE_MAX_NS);
+
+	if (READ_ONCE(dma_dev->poll_hybrid) &&
+	    est >= 2 * DMA_POLL_SLEEP_MIN_NS)
+		usleep_range(div_u64(est, 2000), div_u64(est, 2000) + 1);
+
+	while (dmaengine_tx_status(dma_dev->dmach, cookie, NULL) ==
+	       DMA_IN_PROGRESS) {
+		if (ktime_get_ns() > deadline)
+			return 0;
+		cond_resched();
+		cpu_relax();
+	}
+	t = ktime_get_ns();
+
+	/* 1/8 weight EWMA, races between waiters only blur it */
+	est = est ? est - (est >> 3) + ((t - t0) >> 3) : t - t0;
+	WRITE_ONCE(dma_dev->poll_est_ns[b], est);
+	atomic_long_inc(&dma_dev->poll_waits);
+	return t;
+}
+
+/**********************/
+/******** SYSFS *******/
+/**********************/
+static ssize_t poll_max_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dma_dev->poll_max));
+}
+
+static ssize_t poll_max_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+	u32 val;
+
+	if (kstrtou32(buf, 0, &val))
+		return -EINVAL;
+	WRITE_ONCE(dma_dev->poll_max, val);
+	return count;
+}
+static DEVICE_ATTR_RW(poll_max);
+
+static ssize_t poll_hybrid_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", READ_ONCE(dma_dev->poll_hybrid));
+}
+
+static ssize_t poll_hybrid_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+	WRITE_ONCE(dma_dev->poll_hybrid, val);
+	return count;
+}
+static DEVICE_ATTR_RW(poll_hybrid);
+
+/* "<polled> <irq>" completions waited for by read()/write() */
+static ssize_t poll_count_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct plng_dma_device *dma_dev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%ld %ld\n",
+		       atomic_long_read(&dma_dev->poll_waits),
+		       atomic_long_read(&dma_dev->irq_waits));
+}
+static DEVICE_ATTR_RO(poll_count);
+
+static struct attribute *dma_poll_attrs[] = {
+	&dev_attr_poll_max.attr,
+	&dev_attr_poll_hybrid.attr,
+	&dev_attr_poll_count.attr,
+	NULL,
+};
+
+static const struct attribute_group dma_poll_group = {
+	.attrs = dma_poll_attrs,
+};
+
+/**********************/
+/******** INIT ********/
+/**********************/
+/* Polling is off until poll_max is set */
+int dma_poll_init(struct plng_dma_device *dma_dev)
+{
+	struct device *dev = &dma_dev->pdev->dev;
+	int ret;
+
+	ret = devm_device_add_group(dev, &dma_poll_group);
+	if (ret) {
+		dev_err(dev, "devm_device_add_group() failure\n");
+		return ret;
+	}
+	return 0;
+}
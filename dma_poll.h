@@ -0,0 +1,25 @@
+/**
+ * @file:	dma_poll.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_POLL_H)
+#define DMA_POLL_H
+
+#include <linux/types.h>
+#include <linux/dmaengine.h>
+#include "plng_dma_device.h"
+
+/* Transfers of len bytes are polled for instead of waited for */
+static inline bool dma_poll_want(struct plng_dma_device *dma_dev, size_t len)
+{
+	return len && len <= READ_ONCE(dma_dev->poll_max);
+}
+
+u64 dma_poll_wait(struct plng_dma_device *dma_dev, dma_cookie_t cookie,
+		  size_t len);
+
+int dma_poll_init(struct plng_dma_device *dma_dev);
+
+#endif /* !defined(DMA_POLL_H) */
@@ -0,0 +1,419 @@
+/**
+ * @file:	dma_reg.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/scatterlist.h>
+#include <linux/mmu_notifier.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <asm/current.h>
+
+#include "dma_pg.h"
+#include "dma_reg.h"
+#include "dma_trace.h"
+#include "log.h"
+
+/*
+ * Buffer pinned and mapped once by DMADRV_REGBUF. Transfers that fall
+ * inside it reuse the mapping through a window of its sg entries.
+ */
+struct dma_regbuf {
+	struct plng_dma_ctx *ctx;
+	struct plng_dma_device *dma_dev;
+	usrbuf_t *usrbuf;
+	unsigned long start;
+	unsigned long end;
+	struct mm_struct *mm;
+	struct mmu_notifier mn;
+	bool stale;
+	int users;			/* transfers in flight, reg_lock */
+	unsigned long win_busy;		/* win taken by one of them */
+	struct scatterlist *win;
+};
+
+static inline struct dma_regbuf *mn_to_regbuf(struct mmu_notifier *mn)
+{
+	return container_of(mn, struct dma_regbuf, mn);
+}
+
+/*
+ * reg_lock held, dropped while waiting for transfers using reg.
+ * Returns -EAGAIN instead of waiting if blockable is false.
+ */
+static int regbuf_wait_idle(struct dma_regbuf *reg, bool blockable)
+{
+	struct plng_dma_ctx *ctx = reg->ctx;
+
+	while (reg->users) {
+		if (!blockable)
+			return -EAGAIN;
+		mutex_unlock(&ctx->reg_lock);
+		wait_event(ctx->reg_wait, !READ_ONCE(reg->users));
+		mutex_lock(&ctx->reg_lock);
+	}
+	return 0;
+}
+
+/* reg_lock held, reg stale and idle: its slot goes on the next reap */
+static void regbuf_unpin(struct dma_regbuf *reg)
+{
+	if (!reg->usrbuf)
+		return;
+	put_usr_buf(reg->dma_dev, reg->usrbuf);
+	reg->usrbuf = NULL;
+}
+
+/* Mapping changed under us: stop using the pinned pages */
+static int regbuf_invalidate_range_start(struct mmu_notifier *mn,
+				const struct mmu_notifier_range *range)
+{
+	struct dma_regbuf *reg = mn_to_regbuf(mn);
+	struct plng_dma_ctx *ctx = reg->ctx;
+	bool blockable = mmu_notifier_range_blockable(range);
+	int ret;
+
+	if (range->end <= reg->start || range->start >= reg->end)
+		return 0;
+
+	if (blockable)
+		mutex_lock(&ctx->reg_lock);
+	else if (!mutex_trylock(&ctx->reg_lock))
+		return -EAGAIN;
+
+	/*
+	 * No new users. The last transfer still using the buffer unpins
+	 * it, see regbuf_put(), if we cannot wait for it here.
+	 */
+	reg->stale = true;
+	ret = regbuf_wait_idle(reg, blockable);
+	if (!ret)
+		regbuf_unpin(reg);
+	mutex_unlock(&ctx->reg_lock);
+	return ret;
+}
+
+static void regbuf_release(struct mmu_notifier *mn, struct mm_struct *mm)
+{
+	struct dma_regbuf *reg = mn_to_regbuf(mn);
+
+	mutex_lock(&reg->ctx->reg_lock);
+	reg->stale = true;
+	regbuf_wait_idle(reg, true);
+	regbuf_unpin(reg);
+	mutex_unlock(&reg->ctx->reg_lock);
+}
+
+static const struct mmu_notifier_ops regbuf_mn_ops = {
+	.release = regbuf_release,
+	.invalidate_range_start = regbuf_invalidate_range_start,
+};
+
+static void regbuf_free(struct dma_regbuf *reg)
+{
+	mmu_notifier_unregister(&reg->mn, reg->mm);
+	if (reg->usrbuf)
+		put_usr_buf(reg->dma_dev, reg->usrbuf);
+	kfree(reg->win);
+	kfree(reg);
+}
+
+/*
+ * Fill win with the part of the mapping covering
+ * [off, off + count). Returns number of window entries.
+ */
+static int regbuf_window(struct dma_regbuf *reg, struct scatterlist *win,
+			 size_t off, size_t count)
+{
+	struct scatterlist *sg = reg->usrbuf->sgs;
+	size_t i, len;
+	int n = 0;
+
+	for (i = 0; i != reg->usrbuf->sgnum && count; i++, sg = sg_next(sg)) {
+		len = sg_dma_len(sg);
+		if (off >= len) {
+			off -= len;
+			continue;
+		}
+		len = min(len - off, count);
+		win[n].length = len;
+		sg_dma_address(&win[n]) = sg_dma_address(sg) + off;
+		sg_dma_len(&win[n]) = len;
+		++n;
+		count -= len;
+		off = 0;
+	}
+	return n;
+}
+
+static void regbuf_sync(struct dma_regbuf *reg, struct scatterlist *win,
+			int n, enum dma_transfer_direction dir, int for_device)
+{
+	struct device *dmadev = reg->dma_dev->dmach->device->dev;
+	enum dma_data_direction ddir = reg->usrbuf->dir;
+	int i;
+
+	/* the window has no pages set, sync entries one by one */
+	for (i = 0; i != n; i++) {
+		if (for_device)
+			dma_sync_single_for_device(dmadev,
+						   sg_dma_address(&win[i]),
+						   sg_dma_len(&win[i]), ddir);
+		else if (dir == DMA_DEV_TO_MEM)
+			dma_sync_single_for_cpu(dmadev,
+						sg_dma_address(&win[i]),
+						sg_dma_len(&win[i]), ddir);
+	}
+}
+
+/* Drops a transfer's reference taken by dma_reg_xfer() */
+static void regbuf_put(struct dma_regbuf *reg)
+{
+	struct plng_dma_ctx *ctx = reg->ctx;
+
+	mutex_lock(&ctx->reg_lock);
+	if (!--reg->users) {
+		if (reg->stale)
+			regbuf_unpin(reg);
+		wake_up_all(&ctx->reg_wait);
+	}
+	mutex_unlock(&ctx->reg_lock);
+}
+
+/*
+ * Frees stale entries nobody transfers with. Not under reg_lock:
+ * mmu_notifier_unregister() waits for notifiers that take it.
+ */
+static void regbuf_reap(struct plng_dma_ctx *ctx)
+{
+	struct dma_regbuf *dead[DMADRV_REGBUF_MAX];
+	struct dma_regbuf *reg;
+	size_t i, n = 0;
+
+	mutex_lock(&ctx->reg_lock);
+	for (i = 0; i != DMADRV_REGBUF_MAX; i++) {
+		reg = ctx->regbufs[i];
+		if (reg && reg->stale && !reg->users) {
+			dead[n++] = reg;
+			ctx->regbufs[i] = NULL;
+		}
+	}
+	mutex_unlock(&ctx->reg_lock);
+
+	while (n)
+		regbuf_free(dead[--n]);
+}
+
+/* reg_lock held, *stale set if an entry wants regbuf_reap() */
+static struct dma_regbuf *regbuf_lookup(struct plng_dma_ctx *ctx,
+					unsigned long start, size_t count,
+					bool *stale)
+{
+	struct dma_regbuf *reg;
+	size_t i;
+
+	for (i = 0; i != DMADRV_REGBUF_MAX; i++) {
+		reg = ctx->regbufs[i];
+		if (reg && reg->stale)
+			*stale = true;
+		if (!reg || reg->stale || reg->mm != current->mm)
+			continue;
+		if (start >= reg->start && start < reg->end &&
+		    count <= reg->end - start)
+			return reg;
+	}
+	return NULL;
+}
+
+/**********************/
+/******* XFER *********/
+/**********************/
+ssize_t dma_reg_xfer(struct plng_dma_ctx *ctx,
+		     void __user *buf,
+		     loff_t br_offset,
+		     size_t count,
+		     enum dma_transfer_direction dir,
+		     struct dma_stat_ts *ts)
+{
+	unsigned long start = (unsigned long)buf;
+	struct scatterlist *win;
+	struct dma_regbuf *reg;
+	bool stale = false;
+	ssize_t ret;
+	int n;
+
+	/* the reference keeps the pages pinned, not the lock */
+	mutex_lock(&ctx->reg_lock);
+	reg = regbuf_lookup(ctx, start, count, &stale);
+	if (reg)
+		reg->users++;
+	mutex_unlock(&ctx->reg_lock);
+	if (stale)
+		regbuf_reap(ctx);
+	if (!reg)
+		return -ENOENT;
+
+	/* reg->win for one transfer, concurrent ones get their own */
+	win = reg->win;
+	if (test_and_set_bit_lock(0, &reg->win_busy)) {
+		win = kmalloc_array(reg->usrbuf->sgnum, sizeof(*win),
+				    GFP_KERNEL);
+		if (!win) {
+			ret = -ENOMEM;
+			goto PUT_REG;
+		}
+		sg_init_table(win, reg->usrbuf->sgnum);
+	}
+
+	/* nothing mapped there: pin it like any other buffer */
+	n = regbuf_window(reg, win, start - reg->start, count);
+	if (!n) {
+		ret = -ENOENT;
+		goto PUT_WIN;
+	}
+	ctx->last_sgnum = n;
+	if (ts)
+		trace_dma_drv_sg_mapped(ts, n);
+
+	regbuf_sync(reg, win, n, dir, 1);
+	ret = dma_pg_xfer_sg(ctx, win, n, count, br_offset, dir, ts);
+	regbuf_sync(reg, win, n, dir, 0);
+	if (!ret)
+		ret = count;
+
+PUT_WIN:
+	if (win == reg->win)
+		clear_bit_unlock(0, &reg->win_busy);
+	else
+		kfree(win);
+PUT_REG:
+	regbuf_put(reg);
+	return ret;
+}
+
+/**********************/
+/****** REGISTER ******/
+/**********************/
+long dma_reg_register(struct plng_dma_ctx *ctx,
+		      struct dmadrv_regbuf __user *ureg)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct device *dev = &dma_dev->pdev->dev;
+	struct dmadrv_regbuf req;
+	struct dma_regbuf *reg;
+	long ret;
+	u32 i;
+
+	if (copy_from_user(&req, ureg, sizeof(req)))
+		return -EFAULT;
+	if (!req.len || req.len > INT_MAX || req.flags)
+		return -EINVAL;
+	regbuf_reap(ctx);
+
+	reg = kzalloc(sizeof(*reg), GFP_KERNEL);
+	if (!reg)
+		return -ENOMEM;
+
+	reg->ctx = ctx;
+	reg->dma_dev = dma_dev;
+	reg->start = (unsigned long)req.addr;
+	reg->end = reg->start + req.len;
+	reg->mm = current->mm;
+	reg->mn.ops = &regbuf_mn_ops;
+
+	/* lives as long as the registration, never the arena */
+	reg->usrbuf = get_usr_buf(dma_dev, NULL, u64_to_user_ptr(req.addr),
+				  req.len, DMA_BIDIRECTIONAL);
+	if (!reg->usrbuf) {
+		dev_err(dev, "get_usr_buf() error!\n");
+		ret = -EFAULT;
+		goto FREE_REG;
+	}
+
+	reg->win = kmalloc_array(reg->usrbuf->sgnum, sizeof(*reg->win),
+				 GFP_KERNEL);
+	if (!reg->win) {
+		ret = -ENOMEM;
+		goto PUT_USR_BUF;
+	}
+	sg_init_table(reg->win, reg->usrbuf->sgnum);
+
+	ret = mmu_notifier_register(&reg->mn, reg->mm);
+	if (ret) {
+		dev_err(dev, "mmu_notifier_register() error!\n");
+		goto FREE_WIN;
+	}
+
+	mutex_lock(&ctx->reg_lock);
+	for (i = 0; i != DMADRV_REGBUF_MAX; i++) {
+		if (!ctx->regbufs[i])
+			break;
+	}
+	if (i != DMADRV_REGBUF_MAX)
+		ctx->regbufs[i] = reg;
+	mutex_unlock(&ctx->reg_lock);
+
+	if (i == DMADRV_REGBUF_MAX) {
+		regbuf_free(reg);
+		return -ENOSPC;
+	}
+
+	if (put_user(i, &ureg->handle)) {
+		dma_reg_unregister(ctx, i);
+		return -EFAULT;
+	}
+	return 0;
+
+FREE_WIN:
+	kfree(reg->win);
+PUT_USR_BUF:
+	put_usr_buf(dma_dev, reg->usrbuf);
+FREE_REG:
+	kfree(reg);
+	return ret;
+}
+
+/* Any holder of the file may drop its registrations */
+long dma_reg_unregister(struct plng_dma_ctx *ctx, unsigned long handle)
+{
+	struct dma_regbuf *reg;
+
+	if (handle >= DMADRV_REGBUF_MAX)
+		return -EINVAL;
+
+	mutex_lock(&ctx->reg_lock);
+	reg = ctx->regbufs[handle];
+	ctx->regbufs[handle] = NULL;
+	mutex_unlock(&ctx->reg_lock);
+
+	if (!reg)
+		return -ENOENT;
+
+	/* out of the table, so only transfers already running use it */
+	wait_event(ctx->reg_wait, !READ_ONCE(reg->users));
+	regbuf_free(reg);
+	return 0;
+}
+
+/* release(): nothing can be transferring any more */
+void dma_reg_fini(struct plng_dma_ctx *ctx)
+{
+	size_t i;
+
+	for (i = 0; i != DMADRV_REGBUF_MAX; i++) {
+		if (ctx->regbufs[i])
+			regbuf_free(ctx->regbufs[i]);
+		ctx->regbufs[i] = NULL;
+	}
+}
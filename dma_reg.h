@@ -0,0 +1,29 @@
+/**
+ * @file:	dma_reg.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_REG_H)
+#define DMA_REG_H
+
+#include <linux/types.h>
+#include <linux/dmaengine.h>
+#include "plng_dma_device.h"
+
+struct dma_stat_ts;
+
+/* Returns -ENOENT if [buf, buf + count) is not registered */
+ssize_t dma_reg_xfer(struct plng_dma_ctx *ctx,
+		     void __user *buf,
+		     loff_t br_offset,
+		     size_t count,
+		     enum dma_transfer_direction dir,
+		     struct dma_stat_ts *ts);
+
+long dma_reg_register(struct plng_dma_ctx *ctx,
+		      struct dmadrv_regbuf __user *ureg);
+long dma_reg_unregister(struct plng_dma_ctx *ctx, unsigned long handle);
+void dma_reg_fini(struct plng_dma_ctx *ctx);
+
+#endif /* !defined(DMA_REG_H) */
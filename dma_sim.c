@@ -0,0 +1,738 @@
+/**
+ * @file:	dma_sim.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ *
+ * Simulated bridge, for running the driver on a box without the FPGA.
+ * The bridge window is RAM, fixed address accesses inside the FIFO
+ * window pop and push a queue instead. Transfers go through a software
+ * dmaengine whose descriptors have the PL330 layout, so the khack.h
+ * edits apply to them unchanged.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/io.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/sizes.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/kfifo.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/workqueue.h>
+#include <linux/platform_device.h>
+#include <linux/dma-mapping.h>
+#include <linux/dma-direct.h>
+#include <linux/dmaengine.h>
+
+#include "plng_dma_device.h"
+#include "dma_sim.h"
+#include "khack.h"
+#include "log.h"
+
+static bool sim;
+module_param(sim, bool, 0444);
+MODULE_PARM_DESC(sim, "Register a simulated bridge");
+
+static unsigned int sim_size = SZ_4M;
+module_param(sim_size, uint, 0444);
+MODULE_PARM_DESC(sim_size, "Bridge window size, bytes");
+
+static unsigned int sim_fifo_off;
+module_param(sim_fifo_off, uint, 0444);
+MODULE_PARM_DESC(sim_fifo_off, "FIFO window offset in the bridge");
+
+static unsigned int sim_fifo_len = PAGE_SIZE;
+module_param(sim_fifo_len, uint, 0444);
+MODULE_PARM_DESC(sim_fifo_len, "FIFO window length, bytes");
+
+static unsigned int sim_fifo_depth = SZ_64K;
+module_param(sim_fifo_depth, uint, 0444);
+MODULE_PARM_DESC(sim_fifo_depth, "FIFO depth, bytes, rounded up to a power of 2");
+
+static unsigned int sim_chans = 2;
+module_param(sim_chans, uint, 0444);
+MODULE_PARM_DESC(sim_chans, "Number of DMA channels, 1..8");
+
+static unsigned int sim_bw = 400;
+module_param(sim_bw, uint, 0644);
+MODULE_PARM_DESC(sim_bw, "Bandwidth per channel, MB/s, 0 for unlimited");
+
+static unsigned int sim_lat_us = 5;
+module_param(sim_lat_us, uint, 0644);
+MODULE_PARM_DESC(sim_lat_us, "Issue to first byte latency, us");
+
+struct dma_sim_chan {
+	struct dma_pl330_chan pch;	/* what khack.h expects */
+	struct dma_sim *sim;
+	struct work_struct work;
+	struct dma_pl330_desc *cur;	/* being copied, off the lists */
+};
+
+struct dma_sim {
+	struct platform_device *pdev;	/* dmaengine provider */
+	struct platform_device *client;	/* bound to dma_drv_driver */
+	struct dma_device ddev;
+	struct dma_sim_chan chans[DMA_DRV_CHAN_MAX];
+	struct workqueue_struct *wq;
+
+	void *mem;
+	dma_addr_t mem_dma;
+	size_t size;
+
+	spinlock_t fifo_lock;
+	struct kfifo fifo;
+};
+
+static struct dma_sim *dma_sim;
+
+static inline struct dma_sim_chan *to_sim_chan(struct dma_chan *chan)
+{
+	return container_of(to_pchan(chan), struct dma_sim_chan, pch);
+}
+
+/**********************/
+/******* BRIDGE *******/
+/**********************/
+static inline bool sim_in_fifo(size_t off)
+{
+	return off >= sim_fifo_off && off - sim_fifo_off < sim_fifo_len;
+}
+
+/* inc: bridge side increments, otherwise one word is accessed */
+static bool sim_range(struct dma_sim *s, size_t off, size_t len, bool inc)
+{
+	size_t span = inc ? len : 4;
+
+	if (off > s->size || span > s->size - off) {
+		dev_err_ratelimited(&s->pdev->dev,
+				    "access 0x%zx+%zu outside the bridge\n",
+				    off, span);
+		return false;
+	}
+	return true;
+}
+
+static void sim_read(struct dma_sim *s, void *dst, size_t off, size_t len,
+		     bool inc)
+{
+	u32 *d = dst;
+	unsigned int n;
+	size_t i;
+
+	if (inc) {
+		memcpy(dst, s->mem + off, len);
+	} else if (sim_in_fifo(off)) {
+		n = kfifo_out_spinlocked(&s->fifo, dst, len, &s->fifo_lock);
+		/* empty FIFO reads as zeroes */
+		if (n < len)
+			memset(dst + n, 0, len - n);
+	} else {
+		/* plain register, the same word over and over */
+		for (i = 0; i != len / 4; i++)
+			d[i] = *(u32 *)(s->mem + off);
+	}
+}
+
+static void sim_write(struct dma_sim *s, const void *src, size_t off,
+		      size_t len, bool inc)
+{
+	if (inc)
+		memcpy(s->mem + off, src, len);
+	else if (sim_in_fifo(off))
+		/* full FIFO drops the rest */
+		kfifo_in_spinlocked(&s->fifo, src, len, &s->fifo_lock);
+	else if (len >= 4)
+		/* plain register keeps the last word */
+		memcpy(s->mem + off, src + len - 4, 4);
+}
+
+/**********************/
+/********* PIO ********/
+/**********************/
+static void sim_pio_read(struct plng_dma_device *dma_dev, void *dst,
+			 loff_t br_offset, size_t len, unsigned long fifo)
+{
+	bool inc = fifo != FIFO_ADDR;
+
+	if (sim_range(dma_dev->sim, br_offset, len, inc))
+		sim_read(dma_dev->sim, dst, br_offset, len, inc);
+}
+
+static void sim_pio_write(struct plng_dma_device *dma_dev, const void *src,
+			  loff_t br_offset, size_t len, unsigned long fifo)
+{
+	bool inc = fifo != FIFO_ADDR;
+
+	if (sim_range(dma_dev->sim, br_offset, len, inc))
+		sim_write(dma_dev->sim, src, br_offset, len, inc);
+}
+
+static const struct dma_pio_ops sim_pio_ops = {
+	.read = sim_pio_read,
+	.write = sim_pio_write,
+};
+
+/**********************/
+/******** EXEC ********/
+/**********************/
+/* Bridge offset of a bus address, -1 for memory */
+static long sim_br_off(struct dma_sim *s, u32 addr)
+{
+	if (addr < s->mem_dma || addr - s->mem_dma >= s->size)
+		return -1;
+	return addr - s->mem_dma;
+}
+
+/* Streaming and coherent buffers alike are in the linear map */
+static void *sim_mem(struct dma_sim *s, u32 addr)
+{
+	phys_addr_t phys = dma_to_phys(&s->pdev->dev, addr);
+
+	if (!pfn_valid(PHYS_PFN(phys)))
+		return NULL;
+	return phys_to_virt(phys);
+}
+
+static void sim_exec(struct dma_sim *s, struct dma_pl330_desc *desc)
+{
+	struct pl330_xfer *px = &desc->px;
+	long soff = sim_br_off(s, px->src_addr);
+	long doff = sim_br_off(s, px->dst_addr);
+	void *buf;
+
+	if ((soff < 0) == (doff < 0)) {
+		dev_err_ratelimited(&s->pdev->dev,
+				    "0x%x -> 0x%x does not cross the bridge\n",
+				    px->src_addr, px->dst_addr);
+		return;
+	}
+
+	buf = sim_mem(s, soff >= 0 ? px->dst_addr : px->src_addr);
+	if (!buf) {
+		dev_err_ratelimited(&s->pdev->dev, "0x%x -> 0x%x not in RAM\n",
+				    px->src_addr, px->dst_addr);
+		return;
+	}
+
+	if (soff >= 0) {
+		if (sim_range(s, soff, px->bytes, desc->rqcfg.src_inc))
+			sim_read(s, buf, soff, px->bytes, desc->rqcfg.src_inc);
+	} else {
+		if (sim_range(s, doff, px->bytes, desc->rqcfg.dst_inc))
+			sim_write(s, buf, doff, px->bytes, desc->rqcfg.dst_inc);
+	}
+}
+
+/* Holds the channel until latency + bytes / bandwidth after t0 */
+static void sim_pace(u64 t0, size_t bytes, bool first)
+{
+	unsigned int bw = READ_ONCE(sim_bw);
+	u64 end = t0;
+	s64 left;
+	unsigned long us;
+
+	if (first)
+		end += (u64)READ_ONCE(sim_lat_us) * NSEC_PER_USEC;
+	if (bw)
+		end += div_u64((u64)bytes * 1000, bw);
+
+	left = end - ktime_get_ns();
+	if (left > 20 * NSEC_PER_USEC) {
+		us = div_u64(left, NSEC_PER_USEC);
+		usleep_range(us, us + 5);
+		return;
+	}
+	while ((s64)(end - ktime_get_ns()) > 0)
+		cpu_relax();
+}
+
+/* Runs the work list of one channel in order, cyclic chains forever */
+static void sim_work(struct work_struct *work)
+{
+	struct dma_sim_chan *sc = container_of(work, struct dma_sim_chan, work);
+	struct dma_pl330_chan *pch = &sc->pch;
+	struct dma_pl330_desc *desc;
+	dma_async_tx_callback cb;
+	unsigned long flags;
+	bool first = true, again;
+	void *param;
+	u64 t0;
+
+	for (;;) {
+		spin_lock_irqsave(&pch->lock, flags);
+		desc = list_first_entry_or_null(&pch->work_list,
+						struct dma_pl330_desc, node);
+		if (!desc) {
+			spin_unlock_irqrestore(&pch->lock, flags);
+			break;
+		}
+		list_del_init(&desc->node);
+		desc->status = BUSY;
+		sc->cur = desc;
+		spin_unlock_irqrestore(&pch->lock, flags);
+
+		t0 = ktime_get_ns();
+		sim_exec(sc->sim, desc);
+		sim_pace(t0, desc->px.bytes, first);
+		first = desc->last;
+
+		spin_lock_irqsave(&pch->lock, flags);
+		if (sc->cur != desc) {
+			/* terminated meanwhile */
+			spin_unlock_irqrestore(&pch->lock, flags);
+			kfree(desc);
+			continue;
+		}
+		sc->cur = NULL;
+		cb = desc->txd.callback;
+		param = desc->txd.callback_param;
+		again = pch->cyclic;
+		if (again) {
+			desc->status = PREP;
+			list_add_tail(&desc->node, &pch->work_list);
+		} else {
+			desc->status = DONE;
+			pch->chan.completed_cookie = desc->txd.cookie;
+		}
+		spin_unlock_irqrestore(&pch->lock, flags);
+
+		if (cb)
+			cb(param);
+		if (!again)
+			kfree(desc);
+		cond_resched();
+	}
+}
+
+/**********************/
+/***** DMAENGINE ******/
+/**********************/
+static dma_cookie_t sim_cookie_assign(struct dma_async_tx_descriptor *tx)
+{
+	struct dma_chan *chan = tx->chan;
+	dma_cookie_t cookie = chan->cookie + 1;
+
+	if (cookie < DMA_MIN_COOKIE)
+		cookie = DMA_MIN_COOKIE;
+	tx->cookie = chan->cookie = cookie;
+	return cookie;
+}
+
+/* Same order and cookies as pl330_tx_submit() */
+static dma_cookie_t sim_tx_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct dma_pl330_desc *desc, *last = to_desc(tx);
+	struct dma_pl330_chan *pch = to_pchan(tx->chan);
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	spin_lock_irqsave(&pch->lock, flags);
+	while (!list_empty(&last->node)) {
+		desc = list_first_entry(&last->node, struct dma_pl330_desc,
+					node);
+		if (pch->cyclic) {
+			desc->txd.callback = last->txd.callback;
+			desc->txd.callback_param = last->txd.callback_param;
+		}
+		desc->last = false;
+		sim_cookie_assign(&desc->txd);
+		list_move_tail(&desc->node, &pch->submitted_list);
+	}
+	last->last = true;
+	cookie = sim_cookie_assign(&last->txd);
+	list_add_tail(&last->node, &pch->submitted_list);
+	spin_unlock_irqrestore(&pch->lock, flags);
+	return cookie;
+}
+
+/*
+ * The bridge is memory mapped, so both sides increment until
+ * dma_drv_hack_setfifo() or dma_drv_hack_setsegs() say otherwise.
+ */
+static struct dma_pl330_desc *sim_desc(struct dma_pl330_chan *pch,
+				       dma_addr_t mem, size_t len,
+				       enum dma_transfer_direction dir,
+				       struct dma_pl330_desc *first)
+{
+	struct dma_pl330_desc *desc;
+
+	desc = kzalloc(sizeof(*desc), GFP_NOWAIT);
+	if (!desc)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&desc->txd, &pch->chan);
+	desc->txd.tx_submit = sim_tx_submit;
+	desc->pchan = pch;
+	desc->rqtype = dir;
+	desc->status = PREP;
+	desc->bytes_requested = len;
+	desc->rqcfg.src_inc = 1;
+	desc->rqcfg.dst_inc = 1;
+	desc->px.bytes = len;
+	if (dir == DMA_DEV_TO_MEM) {
+		desc->px.src_addr = pch->fifo_dma;
+		desc->px.dst_addr = mem;
+	} else {
+		desc->px.src_addr = mem;
+		desc->px.dst_addr = pch->fifo_dma;
+	}
+
+	if (first)
+		list_add_tail(&desc->node, &first->node);
+	else
+		INIT_LIST_HEAD(&desc->node);
+	return desc;
+}
+
+static void sim_free_chain(struct dma_pl330_desc *first)
+{
+	struct dma_pl330_desc *desc, *tmp;
+
+	list_for_each_entry_safe(desc, tmp, &first->node, node) {
+		list_del(&desc->node);
+		kfree(desc);
+	}
+	kfree(first);
+}
+
+static struct dma_async_tx_descriptor *
+sim_prep_slave_sg(struct dma_chan *chan, struct scatterlist *sgl,
+		  unsigned int sg_len, enum dma_transfer_direction dir,
+		  unsigned long flags, void *context)
+{
+	struct dma_pl330_chan *pch = to_pchan(chan);
+	struct dma_pl330_desc *first = NULL, *desc = NULL;
+	struct scatterlist *sg;
+	unsigned int i;
+
+	if (dir != DMA_DEV_TO_MEM && dir != DMA_MEM_TO_DEV)
+		return NULL;
+
+	for_each_sg(sgl, sg, sg_len, i) {
+		desc = sim_desc(pch, sg_dma_address(sg), sg_dma_len(sg), dir,
+				first);
+		if (!desc) {
+			if (first)
+				sim_free_chain(first);
+			return NULL;
+		}
+		if (!first)
+			first = desc;
+	}
+	if (!desc)
+		return NULL;
+
+	desc->txd.flags = flags;
+	return &desc->txd;
+}
+
+static struct dma_async_tx_descriptor *
+sim_prep_dma_cyclic(struct dma_chan *chan, dma_addr_t buf, size_t len,
+		    size_t period_len, enum dma_transfer_direction dir,
+		    unsigned long flags)
+{
+	struct dma_pl330_chan *pch = to_pchan(chan);
+	struct dma_pl330_desc *first = NULL, *desc = NULL;
+	size_t off;
+
+	if (dir != DMA_DEV_TO_MEM && dir != DMA_MEM_TO_DEV)
+		return NULL;
+	if (!period_len || len % period_len)
+		return NULL;
+
+	for (off = 0; off != len; off += period_len) {
+		desc = sim_desc(pch, buf + off, period_len, dir, first);
+		if (!desc) {
+			if (first)
+				sim_free_chain(first);
+			return NULL;
+		}
+		if (!first)
+			first = desc;
+	}
+	if (!desc)
+		return NULL;
+
+	/* like pl330, stays set until the channel is freed */
+	pch->cyclic = true;
+	desc->txd.flags = flags;
+	return &desc->txd;
+}
+
+static int sim_config(struct dma_chan *chan, struct dma_slave_config *conf)
+{
+	struct dma_pl330_chan *pch = to_pchan(chan);
+
+	if (conf->direction == DMA_MEM_TO_DEV && conf->dst_addr)
+		pch->fifo_dma = conf->dst_addr;
+	else if (conf->direction == DMA_DEV_TO_MEM && conf->src_addr)
+		pch->fifo_dma = conf->src_addr;
+	return 0;
+}
+
+static void sim_issue_pending(struct dma_chan *chan)
+{
+	struct dma_sim_chan *sc = to_sim_chan(chan);
+	struct dma_pl330_chan *pch = &sc->pch;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pch->lock, flags);
+	list_splice_tail_init(&pch->submitted_list, &pch->work_list);
+	spin_unlock_irqrestore(&pch->lock, flags);
+	queue_work(sc->sim->wq, &sc->work);
+}
+
+static int sim_terminate_all(struct dma_chan *chan)
+{
+	struct dma_sim_chan *sc = to_sim_chan(chan);
+	struct dma_pl330_chan *pch = &sc->pch;
+	struct dma_pl330_desc *desc, *tmp;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&pch->lock, flags);
+	list_splice_tail_init(&pch->submitted_list, &list);
+	list_splice_tail_init(&pch->work_list, &list);
+	/* worker frees the one in flight */
+	sc->cur = NULL;
+	/* pl330 completes every cookie handed out so far */
+	chan->completed_cookie = chan->cookie;
+	spin_unlock_irqrestore(&pch->lock, flags);
+
+	list_for_each_entry_safe(desc, tmp, &list, node)
+		kfree(desc);
+	return 0;
+}
+
+static void sim_synchronize(struct dma_chan *chan)
+{
+	flush_work(&to_sim_chan(chan)->work);
+}
+
+static enum dma_status sim_tx_status(struct dma_chan *chan,
+				     dma_cookie_t cookie,
+				     struct dma_tx_state *txstate)
+{
+	struct dma_pl330_chan *pch = to_pchan(chan);
+	enum dma_status ret;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pch->lock, flags);
+	ret = dma_async_is_complete(cookie, chan->completed_cookie,
+				    chan->cookie);
+	dma_set_tx_state(txstate, chan->completed_cookie, chan->cookie, 0);
+	spin_unlock_irqrestore(&pch->lock, flags);
+	return ret;
+}
+
+static int sim_alloc_chan_resources(struct dma_chan *chan)
+{
+	return 0;
+}
+
+static void sim_free_chan_resources(struct dma_chan *chan)
+{
+	sim_terminate_all(chan);
+	sim_synchronize(chan);
+	to_pchan(chan)->cyclic = false;
+}
+
+/* "rxtx", "rxtx1".."rxtx7" of the client, see dma_init() */
+static const struct dma_slave_map sim_map[DMA_DRV_CHAN_MAX] = {
+	{ "dma_driver", "rxtx", (void *)0 },
+	{ "dma_driver", "rxtx1", (void *)1 },
+	{ "dma_driver", "rxtx2", (void *)2 },
+	{ "dma_driver", "rxtx3", (void *)3 },
+	{ "dma_driver", "rxtx4", (void *)4 },
+	{ "dma_driver", "rxtx5", (void *)5 },
+	{ "dma_driver", "rxtx6", (void *)6 },
+	{ "dma_driver", "rxtx7", (void *)7 },
+};
+
+static bool sim_filter(struct dma_chan *chan, void *param)
+{
+	return chan == &dma_sim->chans[(uintptr_t)param].pch.chan;
+}
+
+static void sim_dmaengine_setup(struct dma_sim *s)
+{
+	struct dma_device *dd = &s->ddev;
+	struct dma_sim_chan *sc;
+	unsigned int i;
+
+	dma_cap_set(DMA_SLAVE, dd->cap_mask);
+	dma_cap_set(DMA_CYCLIC, dd->cap_mask);
+	dma_cap_set(DMA_PRIVATE, dd->cap_mask);
+	dd->dev = &s->pdev->dev;
+	dd->device_alloc_chan_resources = sim_alloc_chan_resources;
+	dd->device_free_chan_resources = sim_free_chan_resources;
+	dd->device_prep_slave_sg = sim_prep_slave_sg;
+	dd->device_prep_dma_cyclic = sim_prep_dma_cyclic;
+	dd->device_config = sim_config;
+	dd->device_terminate_all = sim_terminate_all;
+	dd->device_synchronize = sim_synchronize;
+	dd->device_tx_status = sim_tx_status;
+	dd->device_issue_pending = sim_issue_pending;
+	dd->src_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_4_BYTES);
+	dd->dst_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_4_BYTES);
+	dd->directions = BIT(DMA_DEV_TO_MEM) | BIT(DMA_MEM_TO_DEV);
+	dd->residue_granularity = DMA_RESIDUE_GRANULARITY_DESCRIPTOR;
+	dd->filter.map = sim_map;
+	dd->filter.mapcnt = sim_chans;
+	dd->filter.fn = sim_filter;
+
+	INIT_LIST_HEAD(&dd->channels);
+	for (i = 0; i != sim_chans; i++) {
+		sc = &s->chans[i];
+		sc->sim = s;
+		INIT_WORK(&sc->work, sim_work);
+		spin_lock_init(&sc->pch.lock);
+		INIT_LIST_HEAD(&sc->pch.submitted_list);
+		INIT_LIST_HEAD(&sc->pch.work_list);
+		INIT_LIST_HEAD(&sc->pch.completed_list);
+		sc->pch.chan.device = dd;
+		list_add_tail(&sc->pch.chan.device_node, &dd->channels);
+	}
+}
+
+/**********************/
+/******** INIT ********/
+/**********************/
+bool dma_sim_client(struct platform_device *pdev)
+{
+	return dma_sim && pdev == dma_sim->client;
+}
+
+/* Bridge window of the probed client, instead of its resource */
+int dma_sim_attach(struct plng_dma_device *dma_dev)
+{
+	struct dma_sim *s = dma_sim;
+
+	dma_dev->sim = s;
+	dma_dev->pio = &sim_pio_ops;
+	dma_dev->base = (void __force __iomem *)s->mem;
+	dma_dev->base_phys = dma_to_phys(&s->pdev->dev, s->mem_dma);
+	dma_dev->base_size = s->size;
+	dma_dev->dma_base = s->mem_dma;
+	return 0;
+}
+
+int dma_sim_init(void)
+{
+	/* pl330_xfer addresses are 32 bit */
+	struct platform_device_info info = {
+		.name = "dma_drv_sim",
+		.id = PLATFORM_DEVID_NONE,
+		.dma_mask = DMA_BIT_MASK(32),
+	};
+	struct device *dev;
+	struct dma_sim *s;
+	int ret;
+
+	if (!sim)
+		return 0;
+
+	sim_chans = clamp(sim_chans, 1U, DMA_DRV_CHAN_MAX);
+	sim_size = PAGE_ALIGN(max(sim_size, (unsigned int)PAGE_SIZE));
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	s->pdev = platform_device_register_full(&info);
+	if (IS_ERR(s->pdev)) {
+		pr_err("dma_drv_sim: platform_device_register_full() failure\n");
+		ret = PTR_ERR(s->pdev);
+		goto FREE_SIM;
+	}
+	dev = &s->pdev->dev;
+
+	s->size = sim_size;
+	s->mem = dma_alloc_coherent(dev, s->size, &s->mem_dma, GFP_KERNEL);
+	if (!s->mem) {
+		dev_err(dev, "dma_alloc_coherent(%zu) failure\n", s->size);
+		ret = -ENOMEM;
+		goto UNREG_PDEV;
+	}
+
+	spin_lock_init(&s->fifo_lock);
+	ret = kfifo_alloc(&s->fifo, sim_fifo_depth, GFP_KERNEL);
+	if (ret) {
+		dev_err(dev, "kfifo_alloc() failure\n");
+		goto FREE_MEM;
+	}
+
+	/* channels run in parallel, as PL330 threads do */
+	s->wq = alloc_workqueue("dma_drv_sim", WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (!s->wq) {
+		dev_err(dev, "alloc_workqueue() failure\n");
+		ret = -ENOMEM;
+		goto FREE_FIFO;
+	}
+
+	sim_dmaengine_setup(s);
+	ret = dma_async_device_register(&s->ddev);
+	if (ret) {
+		dev_err(dev, "dma_async_device_register() failure\n");
+		goto DESTROY_WQ;
+	}
+
+	/* probe of the client may run from platform_device_add() */
+	s->client = platform_device_alloc("dma_driver", PLATFORM_DEVID_NONE);
+	if (!s->client) {
+		ret = -ENOMEM;
+		goto DMA_UNREG;
+	}
+	dma_sim = s;
+	ret = platform_device_add(s->client);
+	if (ret) {
+		dev_err(dev, "platform_device_add() failure\n");
+		dma_sim = NULL;
+		platform_device_put(s->client);
+		goto DMA_UNREG;
+	}
+
+	dev_info(dev, "bridge %zu bytes at %pad, fifo 0x%x+%u depth %u, "
+		 "%u chans %u MB/s %u us\n", s->size, &s->mem_dma,
+		 sim_fifo_off, sim_fifo_len, kfifo_size(&s->fifo), sim_chans,
+		 sim_bw, sim_lat_us);
+	return 0;
+
+DMA_UNREG:
+	dma_async_device_unregister(&s->ddev);
+DESTROY_WQ:
+	destroy_workqueue(s->wq);
+FREE_FIFO:
+	kfifo_free(&s->fifo);
+FREE_MEM:
+	dma_free_coherent(dev, s->size, s->mem, s->mem_dma);
+UNREG_PDEV:
+	platform_device_unregister(s->pdev);
+FREE_SIM:
+	kfree(s);
+	return ret;
+}
+
+void dma_sim_fini(void)
+{
+	struct dma_sim *s = dma_sim;
+
+	if (!s)
+		return;
+
+	/* client remove releases the channels */
+	platform_device_unregister(s->client);
+	dma_async_device_unregister(&s->ddev);
+	destroy_workqueue(s->wq);
+	kfifo_free(&s->fifo);
+	dma_free_coherent(&s->pdev->dev, s->size, s->mem, s->mem_dma);
+	platform_device_unregister(s->pdev);
+	dma_sim = NULL;
+	kfree(s);
+}
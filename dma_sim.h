@@ -0,0 +1,46 @@
+/**
+ * @file:	dma_sim.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_SIM_H)
+#define DMA_SIM_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/platform_device.h>
+#include "plng_dma_device.h"
+
+#ifdef CONFIG_PEL_DMA_DRV_SIM
+
+int dma_sim_init(void);
+void dma_sim_fini(void);
+
+bool dma_sim_client(struct platform_device *pdev);
+int dma_sim_attach(struct plng_dma_device *dma_dev);
+
+#else
+
+static inline int dma_sim_init(void)
+{
+	return 0;
+}
+
+static inline void dma_sim_fini(void)
+{
+}
+
+static inline bool dma_sim_client(struct platform_device *pdev)
+{
+	return false;
+}
+
+static inline int dma_sim_attach(struct plng_dma_device *dma_dev)
+{
+	return -ENODEV;
+}
+
+#endif /* CONFIG_PEL_DMA_DRV_SIM */
+
+#endif /* !defined(DMA_SIM_H) */
@@ -0,0 +1,214 @@
+/**
+ * @file:	dma_slot.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/log2.h>
+#include <linux/uaccess.h>
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+
+#include "dma.h"
+#include "dma_slot.h"
+#include "log.h"
+
+static inline size_t slot_size(struct plng_dma_ctx *ctx)
+{
+	return ctx->buf_size / ctx->nslots;
+}
+
+static inline dma_addr_t slot_daddr(struct plng_dma_ctx *ctx, u32 idx)
+{
+	return ctx->dma_buf + (dma_addr_t)idx * slot_size(ctx);
+}
+
+/* every waiter wakes, the next claim reinits */
+static void slot_callback(void *param)
+{
+	struct dma_slot *slot = param;
+	complete_all(&slot->done);
+}
+
+/* ctx->lock held */
+int dma_slot_busy(struct plng_dma_ctx *ctx)
+{
+	u32 i;
+
+	for (i = 0; i != ctx->nslots; i++) {
+		if (ctx->slots[i].state == SLOT_DEV)
+			return 1;
+	}
+	return 0;
+}
+
+/**********************/
+/******* SETUP ********/
+/**********************/
+long dma_slot_setup(struct plng_dma_ctx *ctx, unsigned long nslots)
+{
+	u32 i;
+
+	if (nslots > DMADRV_SLOTS_MAX || (nslots && !is_power_of_2(nslots)))
+		return -EINVAL;
+	if (nslots && ctx->buf_size / nslots < PAGE_SIZE)
+		return -EINVAL;
+
+	mutex_lock(&ctx->lock);
+	if (dma_slot_busy(ctx)) {
+		mutex_unlock(&ctx->lock);
+		return -EBUSY;
+	}
+	for (i = 0; i != nslots; i++) {
+		init_completion(&ctx->slots[i].done);
+		ctx->slots[i].state = SLOT_CPU;
+	}
+	ctx->nslots = nslots;
+	mutex_unlock(&ctx->lock);
+	return 0;
+}
+
+/* Waits out slots still owned by the device, on release */
+void dma_slot_fini(struct plng_dma_ctx *ctx)
+{
+	u32 i;
+
+	for (i = 0; i != ctx->nslots; i++) {
+		if (ctx->slots[i].state == SLOT_DEV)
+			wait_for_completion(&ctx->slots[i].done);
+		ctx->slots[i].state = SLOT_CPU;
+	}
+}
+
+/**********************/
+/******* SUBMIT *******/
+/**********************/
+/* Submit failed after the claim: wake waiters, give the slot back */
+static void slot_abort(struct plng_dma_ctx *ctx, struct dma_slot *slot)
+{
+	mutex_lock(&ctx->lock);
+	slot->cookie = -EIO;
+	slot->state = SLOT_CPU;
+	complete_all(&slot->done);
+	mutex_unlock(&ctx->lock);
+}
+
+/* Hands slot over to the device and returns without waiting */
+long dma_slot_submit(struct plng_dma_ctx *ctx,
+		     struct dmadrv_slot __user *uslot)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_async_tx_descriptor *desc;
+	enum dma_transfer_direction dir;
+	struct dmadrv_slot req;
+	struct dma_slot *slot;
+	dma_addr_t daddr;
+	int ret;
+
+	if (copy_from_user(&req, uslot, sizeof(req)))
+		return -EFAULT;
+	if (req.dir >= INVALID_XFER || !req.len)
+		return -EINVAL;
+	/* same window rules as read()/write() at that offset */
+	if ((req.br_offset & 3) || req.br_offset >= dma_dev->base_size)
+		return -EINVAL;
+	if (ctx->fifo_mode == INCR_ADDR &&
+	    req.len > dma_dev->base_size - req.br_offset)
+		return -EINVAL;
+
+	dir = req.dir == XFER_READ ? DMA_DEV_TO_MEM : DMA_MEM_TO_DEV;
+
+	/* claimed before submit, a second submit or setup sees SLOT_DEV */
+	mutex_lock(&ctx->lock);
+	if (req.slot >= ctx->nslots || req.len > slot_size(ctx)) {
+		mutex_unlock(&ctx->lock);
+		return -EINVAL;
+	}
+	slot = &ctx->slots[req.slot];
+	if (slot->state != SLOT_CPU) {
+		mutex_unlock(&ctx->lock);
+		return -EBUSY;
+	}
+	ret = dma_buf_alloc(ctx);
+	if (ret) {
+		mutex_unlock(&ctx->lock);
+		return ret;
+	}
+	reinit_completion(&slot->done);
+	slot->dir = dir;
+	slot->len = req.len;
+	slot->state = SLOT_DEV;
+	daddr = slot_daddr(ctx, req.slot);
+	mutex_unlock(&ctx->lock);
+
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		goto ABORT;
+
+	dma_buf_sync_dev(ctx, daddr, req.len, dir);
+	desc = dma_prep_iobuf(dma_dev, daddr, req.br_offset, req.len, dir,
+			      ctx->fifo_mode, NULL);
+	if (!desc) {
+		dma_chan_put(dma_dev);
+		ret = -EIO;
+		goto ABORT;
+	}
+	dma_buf_hack_cache(ctx, desc, dir);
+
+	desc->callback = slot_callback;
+	desc->callback_param = slot;
+	slot->cookie = dma_chan_submit(dma_dev, desc);
+	dma_chan_put(dma_dev);
+	if (dma_submit_error(slot->cookie)) {
+		ret = -EIO;
+		goto ABORT;
+	}
+	return 0;
+
+ABORT:
+	slot_abort(ctx, slot);
+	return ret;
+}
+
+/**********************/
+/******** WAIT ********/
+/**********************/
+/* Takes slot back from the device once its transfer is done */
+long dma_slot_wait(struct plng_dma_ctx *ctx, unsigned long idx)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_slot *slot;
+	long ret = 0;
+
+	mutex_lock(&ctx->lock);
+	if (idx >= ctx->nslots || ctx->slots[idx].state != SLOT_DEV) {
+		mutex_unlock(&ctx->lock);
+		return -EINVAL;
+	}
+	slot = &ctx->slots[idx];
+	mutex_unlock(&ctx->lock);
+
+	/* setup is refused while the slot is SLOT_DEV, slot stays valid */
+	if (wait_for_completion_interruptible(&slot->done))
+		return -ERESTARTSYS;
+
+	mutex_lock(&ctx->lock);
+	if (dma_submit_error(slot->cookie) ||
+	    dmaengine_tx_status(dma_dev->dmach, slot->cookie, NULL) !=
+	    DMA_COMPLETE)
+		ret = -EIO;
+	/* concurrent waiters: the first one hands the slot back */
+	if (slot->state == SLOT_DEV) {
+		dma_buf_sync_cpu(ctx, slot_daddr(ctx, idx), slot->len,
+				 slot->dir);
+		slot->state = SLOT_CPU;
+	}
+	mutex_unlock(&ctx->lock);
+	return ret;
+}
@@ -0,0 +1,20 @@
+/**
+ * @file:	dma_slot.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_SLOT_H)
+#define DMA_SLOT_H
+
+#include <linux/types.h>
+#include "plng_dma_device.h"
+
+long dma_slot_setup(struct plng_dma_ctx *ctx, unsigned long nslots);
+void dma_slot_fini(struct plng_dma_ctx *ctx);
+long dma_slot_submit(struct plng_dma_ctx *ctx,
+		     struct dmadrv_slot __user *uslot);
+long dma_slot_wait(struct plng_dma_ctx *ctx, unsigned long idx);
+int dma_slot_busy(struct plng_dma_ctx *ctx);
+
+#endif /* !defined(DMA_SLOT_H) */
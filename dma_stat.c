@@ -0,0 +1,117 @@
+/**
+ * @file:	dma_stat.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/atomic.h>
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/dmaengine.h>
+
+#include "dma_stat.h"
+#include "log.h"
+
+static const char * const stat_mode_names[DMA_STAT_NMODES] = {
+	"DUMB", "DMA", "DMAPG",
+};
+
+static const char * const stat_stage_names[DMA_STAT_NSTAGES] = {
+	"pin", "config", "prep", "hw", "wake", "total",
+};
+
+/* bucket k counts [2^(k-1), 2^k) ns, last one everything above */
+static inline unsigned stat_bucket(u64 ns)
+{
+	return min_t(unsigned, fls64(ns), DMA_STAT_BUCKETS - 1);
+}
+
+void dma_stat_account(struct plng_dma_device *dma_dev,
+		      struct dma_stat_ts *ts)
+{
+	struct dma_stat_hist *h;
+	int wr = ts->dir == DMA_MEM_TO_DEV;
+	int stage;
+
+	if (ts->mode >= DMA_STAT_NMODES)
+		return;
+
+	h = dma_dev->stats[ts->mode][wr];
+	for (stage = 0; stage != DMA_STAT_NSTAGES; stage++) {
+		if (ts->ns[stage])
+			atomic_long_inc(&h[stage].b[stat_bucket(ts->ns[stage])]);
+	}
+}
+
+/**********************/
+/******* DEBUGFS ******/
+/**********************/
+static int stats_show(struct seq_file *s, void *unused)
+{
+	struct plng_dma_device *dma_dev = s->private;
+	struct dma_stat_hist *h;
+	unsigned mode, rd, stage, k;
+	long n, total;
+
+	seq_puts(s, "op stage: k:count, bucket k is [2^(k-1), 2^k) ns\n");
+	for (mode = 0; mode != DMA_STAT_NMODES; mode++) {
+		for (rd = 0; rd != 2; rd++) {
+			for (stage = 0; stage != DMA_STAT_NSTAGES; stage++) {
+				h = &dma_dev->stats[mode][rd][stage];
+				for (k = 0, total = 0; k != DMA_STAT_BUCKETS; k++)
+					total += atomic_long_read(&h->b[k]);
+				if (!total)
+					continue;
+				seq_printf(s, "%s_%s %s:", stat_mode_names[mode],
+					   rd ? "WRITE" : "READ",
+					   stat_stage_names[stage]);
+				for (k = 0; k != DMA_STAT_BUCKETS; k++) {
+					n = atomic_long_read(&h->b[k]);
+					if (n)
+						seq_printf(s, " %u:%ld", k, n);
+				}
+				seq_putc(s, '\n');
+			}
+		}
+	}
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, inode->i_private);
+}
+
+/* any write clears all histograms */
+static ssize_t stats_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct plng_dma_device *dma_dev = s->private;
+	atomic_long_t *b = &dma_dev->stats[0][0][0].b[0];
+	size_t i, n = sizeof(dma_dev->stats) / sizeof(*b);
+
+	for (i = 0; i != n; i++)
+		atomic_long_set(&b[i], 0);
+	return count;
+}
+
+static const struct file_operations stats_fops = {
+	.owner = THIS_MODULE,
+	.open = stats_open,
+	.read = seq_read,
+	.write = stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void dma_stat_init(struct plng_dma_device *dma_dev)
+{
+	/* debugfs is optional, errors are not fatal */
+	debugfs_create_file("stats", 0600, dma_dev->dbg_dir, dma_dev,
+			    &stats_fops);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file:	dma_stat.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_STAT_H)
+#define DMA_STAT_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/dmaengine.h>
+#include "plng_dma_device.h"
+
+/*
+ * One transfer as asked for by userspace and its stage durations,
+ * 0 if the stage did not run. Also what the tracepoints report.
+ */
+struct dma_stat_ts {
+	loff_t br_offset;
+	size_t len;
+	unsigned long mode;
+	unsigned long fifo;
+	enum dma_transfer_direction dir;
+	u64 ns[DMA_STAT_NSTAGES];
+};
+
+/* Adds now - t0 to stage, returns now for the next stage */
+static inline u64 dma_stat_add(struct dma_stat_ts *ts, int stage, u64 t0)
+{
+	u64 now;
+
+	if (!ts)
+		return 0;
+	now = ktime_get_ns();
+	ts->ns[stage] += now - t0;
+	return now;
+}
+
+static inline u64 dma_stat_now(struct dma_stat_ts *ts)
+{
+	return ts ? ktime_get_ns() : 0;
+}
+
+void dma_stat_account(struct plng_dma_device *dma_dev,
+		      struct dma_stat_ts *ts);
+
+void dma_stat_init(struct plng_dma_device *dma_dev);
+
+#endif /* !defined(DMA_STAT_H) */
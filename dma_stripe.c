@@ -0,0 +1,190 @@
+/**
+ * @file:	dma_stripe.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/slab.h>
+#include <linux/completion.h>
+#include <linux/scatterlist.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+
+#include "dma.h"
+#include "dma_stripe.h"
+#include "khack.h"
+#include "log.h"
+
+/* parts start on a burst boundary */
+#define DMA_DRV_STRIPE_ALIGN	(64U)
+
+/* Number of channels a transfer of count bytes is split across */
+unsigned dma_stripe_count(struct plng_dma_ctx *ctx, size_t count)
+{
+	if (ctx->fifo_mode != INCR_ADDR || count < DMADRV_STRIPE_MIN)
+		return 1;
+	return min_t(unsigned, ctx->stripes, ctx->dma_dev->nchans);
+}
+
+/*
+ * Fill part with the piece of the mapped sgs covering
+ * [skip, skip + len). Returns number of part entries.
+ */
+static int stripe_cut(struct scatterlist *sgs, unsigned int sgnum,
+		      size_t skip, size_t len, struct scatterlist *part)
+{
+	struct scatterlist *sg;
+	size_t slen;
+	unsigned int i;
+	int n = 0;
+
+	for_each_sg(sgs, sg, sgnum, i) {
+		if (!len)
+			break;
+		slen = sg_dma_len(sg);
+		if (skip >= slen) {
+			skip -= slen;
+			continue;
+		}
+		slen = min(slen - skip, len);
+		part[n].length = slen;
+		sg_dma_address(&part[n]) = sg_dma_address(sg) + skip;
+		sg_dma_len(&part[n]) = slen;
+		++n;
+		len -= slen;
+		skip = 0;
+	}
+	return n;
+}
+
+static void stripe_callback(void *param)
+{
+	complete(param);
+}
+
+/* chan_lock held */
+static struct dma_async_tx_descriptor *
+stripe_prep(struct plng_dma_device *dma_dev,
+	    struct dma_chan *chan,
+	    struct scatterlist *part,
+	    int nents,
+	    loff_t br_offset,
+	    enum dma_transfer_direction dir)
+{
+	struct device *dev = &dma_dev->pdev->dev;
+	struct dma_async_tx_descriptor *desc;
+	struct dma_slave_config conf;
+
+	memzero_explicit(&conf, sizeof(struct dma_slave_config));
+	conf.direction = dir;
+	if (dir == DMA_DEV_TO_MEM)
+		conf.src_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
+	else
+		conf.dst_addr = (phys_addr_t)(dma_dev->dma_base + br_offset);
+	conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	conf.src_maxburst = 16;
+	conf.dst_maxburst = 16;
+
+	if (dmaengine_slave_config(chan, &conf) < 0) {
+		dev_err(dev, "dmaengine_slave_config() failure\n");
+		return NULL;
+	}
+
+	desc = dmaengine_prep_slave_sg(chan, part, nents, dir,
+				       DMA_PREP_INTERRUPT);
+	if (IS_ERR_OR_NULL(desc)) {
+		dev_err(dev, "dmaengine_prep_slave_sg() failure\n");
+		return NULL;
+	}
+
+	/* INCR_ADDR only, both sides increment */
+	dma_drv_hack_chdir(desc);
+	return desc;
+}
+
+/**********************/
+/******* STRIPE *******/
+/**********************/
+/*
+ * Split count bytes of the mapped sgs into nstripes consecutive parts,
+ * part i going to bridge offset br_offset + i * part length on channel
+ * i. All parts run in parallel, returns once every queued one is done.
+ */
+int dma_stripe_xfer(struct plng_dma_device *dma_dev,
+		    unsigned nstripes,
+		    struct scatterlist *sgs,
+		    unsigned int sgnum,
+		    size_t count,
+		    loff_t br_offset,
+		    enum dma_transfer_direction dir)
+{
+	struct device *dev = &dma_dev->pdev->dev;
+	struct completion done[DMA_DRV_CHAN_MAX];
+	dma_cookie_t cookies[DMA_DRV_CHAN_MAX];
+	struct dma_async_tx_descriptor *desc;
+	struct scatterlist *parts, *part;
+	struct dma_chan *chan;
+	size_t plen, len, off = 0;
+	unsigned i, queued = 0;
+	int nents, ret;
+
+	plen = ALIGN(DIV_ROUND_UP(count, nstripes), DMA_DRV_STRIPE_ALIGN);
+
+	parts = kmalloc_array(nstripes * sgnum, sizeof(*parts), GFP_KERNEL);
+	if (!parts)
+		return -ENOMEM;
+
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		goto FREE_PARTS;
+
+	for (i = 0; i != nstripes && off < count; i++, off += plen) {
+		chan = dma_dev->dmachs[i];
+		part = parts + i * sgnum;
+		len = min(plen, count - off);
+
+		sg_init_table(part, sgnum);
+		nents = stripe_cut(sgs, sgnum, off, len, part);
+
+		desc = stripe_prep(dma_dev, chan, part, nents,
+				   br_offset + off, dir);
+		if (!desc) {
+			ret = -EIO;
+			break;
+		}
+
+		init_completion(&done[i]);
+		desc->callback = stripe_callback;
+		desc->callback_param = &done[i];
+		cookies[i] = dmaengine_submit(desc);
+		if (dma_submit_error(cookies[i])) {
+			dev_err(dev, "dma_submit() failure\n");
+			ret = -EIO;
+			break;
+		}
+		if (chan == dma_dev->dmach)
+			dma_dev->last_cookie = cookies[i];
+
+		dma_async_issue_pending(chan);
+		++queued;
+	}
+	dma_chan_put(dma_dev);
+
+	/* queued parts must finish before done[] goes out of scope */
+	for (i = 0; i != queued; i++) {
+		wait_for_completion(&done[i]);
+		if (dmaengine_tx_status(dma_dev->dmachs[i], cookies[i], NULL) !=
+		    DMA_COMPLETE)
+			ret = -EIO;
+	}
+
+FREE_PARTS:
+	kfree(parts);
+	return ret;
+}
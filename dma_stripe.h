@@ -0,0 +1,24 @@
+/**
+ * @file:	dma_stripe.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_STRIPE_H)
+#define DMA_STRIPE_H
+
+#include <linux/types.h>
+#include <linux/scatterlist.h>
+#include "plng_dma_device.h"
+
+unsigned dma_stripe_count(struct plng_dma_ctx *ctx, size_t count);
+
+int dma_stripe_xfer(struct plng_dma_device *dma_dev,
+		    unsigned nstripes,
+		    struct scatterlist *sgs,
+		    unsigned int sgnum,
+		    size_t count,
+		    loff_t br_offset,
+		    enum dma_transfer_direction dir);
+
+#endif /* !defined(DMA_STRIPE_H) */
@@ -0,0 +1,125 @@
+/**
+ * @file:	dma_trace.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dma_drv
+
+#if !defined(DMA_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define DMA_TRACE_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+#include "rlsctl.h"
+#include "dma_stat.h"
+
+#define show_dma_drv_mode(mode)					\
+	__print_symbolic(mode,					\
+			 { DUMB_OPMODE,		"DUMB" },	\
+			 { DMA_OPMODE,		"DMA" },	\
+			 { DMAPG_OPMODE,	"DMAPG" })
+
+/* One transfer, identified by what userspace asked for */
+DECLARE_EVENT_CLASS(dma_drv_xfer,
+
+	TP_PROTO(const struct dma_stat_ts *ts),
+
+	TP_ARGS(ts),
+
+	TP_STRUCT__entry(
+		__field(u64, br_offset)
+		__field(size_t, len)
+		__field(u32, mode)
+		__field(u32, fifo)
+		__field(u32, write)
+	),
+
+	TP_fast_assign(
+		__entry->br_offset = ts->br_offset;
+		__entry->len = ts->len;
+		__entry->mode = ts->mode;
+		__entry->fifo = ts->fifo == FIFO_ADDR;
+		__entry->write = ts->dir == DMA_MEM_TO_DEV;
+	),
+
+	TP_printk("%s %s off=0x%llx len=%zu %s",
+		  show_dma_drv_mode(__entry->mode),
+		  __entry->write ? "WRITE" : "READ",
+		  __entry->br_offset, __entry->len,
+		  __entry->fifo ? "fifo" : "incr")
+);
+
+/* read()/write() entered the op */
+DEFINE_EVENT(dma_drv_xfer, dma_drv_submit,
+	TP_PROTO(const struct dma_stat_ts *ts),
+	TP_ARGS(ts));
+
+/* user pages pinned */
+DEFINE_EVENT(dma_drv_xfer, dma_drv_pin_done,
+	TP_PROTO(const struct dma_stat_ts *ts),
+	TP_ARGS(ts));
+
+/* descriptor submitted and issued to the channel */
+DEFINE_EVENT(dma_drv_xfer, dma_drv_issued,
+	TP_PROTO(const struct dma_stat_ts *ts),
+	TP_ARGS(ts));
+
+/* completion callback, tasklet context */
+DEFINE_EVENT(dma_drv_xfer, dma_drv_callback,
+	TP_PROTO(const struct dma_stat_ts *ts),
+	TP_ARGS(ts));
+
+/* waiter running again after the callback */
+DEFINE_EVENT(dma_drv_xfer, dma_drv_woken,
+	TP_PROTO(const struct dma_stat_ts *ts),
+	TP_ARGS(ts));
+
+/* pinned pages, IOBUF or PIO staging buffer handed back */
+DEFINE_EVENT(dma_drv_xfer, dma_drv_released,
+	TP_PROTO(const struct dma_stat_ts *ts),
+	TP_ARGS(ts));
+
+/* sg table mapped for the device */
+TRACE_EVENT(dma_drv_sg_mapped,
+
+	TP_PROTO(const struct dma_stat_ts *ts, unsigned int nents),
+
+	TP_ARGS(ts, nents),
+
+	TP_STRUCT__entry(
+		__field(u64, br_offset)
+		__field(size_t, len)
+		__field(u32, mode)
+		__field(u32, fifo)
+		__field(u32, write)
+		__field(unsigned int, nents)
+	),
+
+	TP_fast_assign(
+		__entry->br_offset = ts->br_offset;
+		__entry->len = ts->len;
+		__entry->mode = ts->mode;
+		__entry->fifo = ts->fifo == FIFO_ADDR;
+		__entry->write = ts->dir == DMA_MEM_TO_DEV;
+		__entry->nents = nents;
+	),
+
+	TP_printk("%s %s off=0x%llx len=%zu %s nents=%u",
+		  show_dma_drv_mode(__entry->mode),
+		  __entry->write ? "WRITE" : "READ",
+		  __entry->br_offset, __entry->len,
+		  __entry->fifo ? "fifo" : "incr",
+		  __entry->nents)
+);
+
+#endif /* !defined(DMA_TRACE_H) || defined(TRACE_HEADER_MULTI_READ) */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE dma_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,265 @@
+/**
+ * @file:	dma_xfer.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/errno.h>
+
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/scatterlist.h>
+#include <linux/dmaengine.h>
+
+#include "dma.h"
+#include "dma_xfer.h"
+#include "dma_stat.h"
+#include "dma_trace.h"
+#include "khack.h"
+#include "log.h"
+
+/*
+ * DMADRV_XFER_CREATE result. desc is prepared and patched once and
+ * resubmitted by every launch when the channel reuses descriptors,
+ * NULL otherwise.
+ */
+struct dma_xferobj {
+	struct dma_slave_config conf;
+	struct scatterlist sg;
+	struct dma_async_tx_descriptor *desc;
+	dma_addr_t daddr;
+	loff_t br_offset;
+	size_t len;
+	enum dma_transfer_direction dir;
+	unsigned long fifo;
+};
+
+/* chan_lock held */
+static struct dma_async_tx_descriptor *
+xferobj_prep(struct plng_dma_ctx *ctx, struct dma_xferobj *obj)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct device *dev = &dma_dev->pdev->dev;
+	struct dma_async_tx_descriptor *desc;
+
+	if (dmaengine_slave_config(dma_dev->dmach, &obj->conf) < 0) {
+		dev_err(dev, "dmaengine_slave_config() failure\n");
+		return NULL;
+	}
+
+	desc = dmaengine_prep_slave_sg(dma_dev->dmach, &obj->sg, 1, obj->dir,
+				       DMA_PREP_INTERRUPT);
+	if (IS_ERR_OR_NULL(desc)) {
+		dev_err(dev, "dmaengine_prep_slave_sg() failure\n");
+		return NULL;
+	}
+
+	dma_drv_hack_chdir(desc);
+	if (obj->fifo == FIFO_ADDR)
+		dma_drv_hack_setfifo(desc, obj->dir);
+	dma_buf_hack_cache(ctx, desc, obj->dir);
+	return desc;
+}
+
+static void xferobj_free(struct dma_xferobj *obj)
+{
+	/* never in flight, launches wait under ctx->lock */
+	if (obj->desc)
+		dmaengine_desc_free(obj->desc);
+	kfree(obj);
+}
+
+/**********************/
+/******* CREATE *******/
+/**********************/
+long dma_xfer_create(struct plng_dma_ctx *ctx,
+		     struct dmadrv_xferobj __user *uobj)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_async_tx_descriptor *desc;
+	struct dmadrv_xferobj req;
+	struct dma_slave_caps caps;
+	struct dma_xferobj *obj;
+	long ret;
+	u32 i;
+
+	if (copy_from_user(&req, uobj, sizeof(req)))
+		return -EFAULT;
+	if (req.dir >= INVALID_XFER || !req.len || req.flags)
+		return -EINVAL;
+	if (req.br_offset >= dma_dev->base_size)
+		return -EINVAL;
+	if (ctx->fifo_mode == INCR_ADDR &&
+	    req.len > dma_dev->base_size - req.br_offset)
+		return -EINVAL;
+
+	obj = kzalloc(sizeof(*obj), GFP_KERNEL);
+	if (!obj)
+		return -ENOMEM;
+
+	obj->dir = req.dir == XFER_READ ? DMA_DEV_TO_MEM : DMA_MEM_TO_DEV;
+	obj->br_offset = req.br_offset;
+	obj->len = req.len;
+	obj->fifo = ctx->fifo_mode;
+
+	obj->conf.direction = obj->dir;
+	if (obj->dir == DMA_DEV_TO_MEM)
+		obj->conf.src_addr = (phys_addr_t)(dma_dev->dma_base +
+						   req.br_offset);
+	else
+		obj->conf.dst_addr = (phys_addr_t)(dma_dev->dma_base +
+						   req.br_offset);
+	obj->conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	obj->conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	obj->conf.src_maxburst = 16;
+	obj->conf.dst_maxburst = 16;
+
+	mutex_lock(&ctx->lock);
+	ret = dma_buf_alloc(ctx);
+	if (ret)
+		goto UNLOCK;
+	if (req.offset >= ctx->buf_size ||
+	    req.len > ctx->buf_size - req.offset) {
+		ret = -EINVAL;
+		goto UNLOCK;
+	}
+	obj->daddr = ctx->dma_buf + req.offset;
+
+	sg_init_table(&obj->sg, 1);
+	obj->sg.length = obj->len;
+	sg_dma_address(&obj->sg) = obj->daddr;
+	sg_dma_len(&obj->sg) = obj->len;
+
+	for (i = 0; i != DMADRV_XFEROBJ_MAX; i++) {
+		if (!ctx->xferobjs[i])
+			break;
+	}
+	if (i == DMADRV_XFEROBJ_MAX) {
+		ret = -ENOSPC;
+		goto UNLOCK;
+	}
+
+	if (!dma_get_slave_caps(dma_dev->dmach, &caps) &&
+	    caps.descriptor_reuse) {
+		ret = dma_chan_get(dma_dev);
+		if (ret)
+			goto UNLOCK;
+		desc = xferobj_prep(ctx, obj);
+		dma_chan_put(dma_dev);
+		if (!desc) {
+			ret = -EIO;
+			goto UNLOCK;
+		}
+		/* cannot fail, caps were checked */
+		dmaengine_desc_set_reuse(desc);
+		obj->desc = desc;
+	}
+
+	ctx->xferobjs[i] = obj;
+	mutex_unlock(&ctx->lock);
+
+	if (put_user(i, &uobj->handle)) {
+		dma_xfer_destroy(ctx, i);
+		return -EFAULT;
+	}
+	return 0;
+
+UNLOCK:
+	mutex_unlock(&ctx->lock);
+	kfree(obj);
+	return ret;
+}
+
+/**********************/
+/******* LAUNCH *******/
+/**********************/
+/* Runs the object and waits for it, like read()/write() in DMA_OPMODE */
+long dma_xfer_launch(struct plng_dma_ctx *ctx, unsigned long handle)
+{
+	struct plng_dma_device *dma_dev = ctx->dma_dev;
+	struct dma_async_tx_descriptor *desc;
+	struct dma_xferobj *obj;
+	struct dma_stat_ts ts = {
+		.mode = DMA_OPMODE,
+	};
+	u64 t0;
+	long ret;
+
+	if (handle >= DMADRV_XFEROBJ_MAX)
+		return -EINVAL;
+
+	mutex_lock(&ctx->lock);
+	obj = ctx->xferobjs[handle];
+	if (!obj) {
+		ret = -ENOENT;
+		goto UNLOCK;
+	}
+
+	ts.br_offset = obj->br_offset;
+	ts.len = obj->len;
+	ts.fifo = obj->fifo;
+	ts.dir = obj->dir;
+	t0 = dma_stat_now(&ts);
+	trace_dma_drv_submit(&ts);
+
+	dma_buf_sync_dev(ctx, obj->daddr, obj->len, obj->dir);
+
+	ret = dma_chan_get(dma_dev);
+	if (ret)
+		goto UNLOCK;
+	desc = obj->desc ? obj->desc : xferobj_prep(ctx, obj);
+	if (!desc) {
+		dma_chan_put(dma_dev);
+		ret = -EIO;
+		goto UNLOCK;
+	}
+
+	ret = dma_submit_and_wait(dma_dev, desc, &ts);
+	dma_buf_sync_cpu(ctx, obj->daddr, obj->len, obj->dir);
+	if (!ret) {
+		dma_stat_add(&ts, DMA_STAT_TOTAL, t0);
+		dma_stat_account(dma_dev, &ts);
+		trace_dma_drv_released(&ts);
+	}
+
+UNLOCK:
+	mutex_unlock(&ctx->lock);
+	return ret;
+}
+
+/**********************/
+/******* DESTROY ******/
+/**********************/
+long dma_xfer_destroy(struct plng_dma_ctx *ctx, unsigned long handle)
+{
+	struct dma_xferobj *obj;
+
+	if (handle >= DMADRV_XFEROBJ_MAX)
+		return -EINVAL;
+
+	mutex_lock(&ctx->lock);
+	obj = ctx->xferobjs[handle];
+	ctx->xferobjs[handle] = NULL;
+	mutex_unlock(&ctx->lock);
+
+	if (!obj)
+		return -ENOENT;
+	xferobj_free(obj);
+	return 0;
+}
+
+/* On release, before IOBUF goes away */
+void dma_xfer_fini(struct plng_dma_ctx *ctx)
+{
+	u32 i;
+
+	for (i = 0; i != DMADRV_XFEROBJ_MAX; i++) {
+		if (ctx->xferobjs[i])
+			xferobj_free(ctx->xferobjs[i]);
+		ctx->xferobjs[i] = NULL;
+	}
+}
@@ -0,0 +1,19 @@
+/**
+ * @file:	dma_xfer.h
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ */
+
+#if !defined(DMA_XFER_H)
+#define DMA_XFER_H
+
+#include <linux/types.h>
+#include "plng_dma_device.h"
+
+long dma_xfer_create(struct plng_dma_ctx *ctx,
+		     struct dmadrv_xferobj __user *uobj);
+long dma_xfer_launch(struct plng_dma_ctx *ctx, unsigned long handle);
+long dma_xfer_destroy(struct plng_dma_ctx *ctx, unsigned long handle);
+void dma_xfer_fini(struct plng_dma_ctx *ctx);
+
+#endif /* !defined(DMA_XFER_H) */
@@ -1,8 +1,15 @@
 #include <linux/module.h>
 
 #include <linux/types.h>
+#include <linux/kernel.h>
 #include <asm/io.h>
 
+#if defined(CONFIG_ARM) && defined(CONFIG_KERNEL_MODE_NEON)
+#include <asm/neon.h>
+#include <asm/simd.h>
+#define IOMEMCPY_HAVE_NEON
+#endif
+
 #include "iomemcpy.h"
 
 MODULE_LICENSE("GPL");
@@ -16,6 +23,17 @@ do {									\
 		return (0);						\
 } while (0)
 
+/* io side of a NEON copy needs 64 bit aligned bursts */
+#define	fail_on_inval_neon_args(addr1, addr2, len)			\
+do {									\
+	if (0UL != (((unsigned long)(addr1) | (unsigned long)(addr2)) & 7UL) \
+	    || 0U != ((len) & (IOMEMCPY_NEON_BLOCK - 1U)))		\
+		return (0);						\
+} while (0)
+
+/* preemption is off inside kernel_neon_begin/end, bound it */
+#define IOMEMCPY_NEON_CHUNK	(4096U)
+
 int iomemcpy32_fromio(void *dst, const volatile void __iomem * src, size_t len)
 {
 	fail_on_inval_args(dst, src, len, 4U);
@@ -42,9 +60,14 @@ int iomemcpy64_fromio(void *dst, const volatile void __iomem * src, size_t len)
 {
 	fail_on_inval_args(dst, src, len, 8U);
 	for (; 0U != len; len -= 8U) {
+#ifdef CONFIG_ARM
 		asm volatile ("ldrd %1, %0, #8":"+Qo"
 			      (*((volatile u32 __force *)src)),
 			      "=r"(*((u64 *) dst)));
+#else
+		memcpy_fromio(dst, src, 8U);
+		src = (const volatile void __iomem *)((u8 *) src + 8U);
+#endif
 		dst = (void *)((u8 *) dst + 8U);
 	}
 	return (1);
@@ -75,10 +98,107 @@ int iomemcpy64_toio(volatile void __iomem * dst, const void *src, size_t len)
 {
 	fail_on_inval_args(dst, src, len, 8U);
 	for (; 0U != len; len -= 8U) {
+#ifdef CONFIG_ARM
 		asm volatile ("strd %1, %0, #8":"+Qo"
 			      (*((volatile u32 __force *)dst))
 			      :"r"(*((u64 *) src)));
+#else
+		memcpy_toio(dst, src, 8U);
+		dst = (volatile void __iomem *)((u8 *) dst + 8U);
+#endif
 		src = (const void *)((u8 *) src + 8U);
 	}
 	return (1);
 }
+
+#ifdef IOMEMCPY_HAVE_NEON
+/* one IOMEMCPY_NEON_BLOCK burst, d0-d7 */
+static inline void neon_block(void *dst, const volatile void *src,
+			      bool toio)
+{
+	asm volatile ("vld1.64 {d0-d3}, [%0:64]!\n\t"
+		      "vld1.64 {d4-d7}, [%0:64]\n\t"
+		      "vst1.64 {d0-d3}, [%1:64]!\n\t"
+		      "vst1.64 {d4-d7}, [%1:64]\n\t"
+		      : "+r"(src), "+r"(dst)
+		      :
+		      : "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+			"memory");
+}
+#else
+static inline void neon_block(void *dst, const volatile void *src,
+			      bool toio)
+{
+	if (toio)
+		memcpy_toio((volatile void __iomem __force *)dst,
+			    (const void __force *)src, IOMEMCPY_NEON_BLOCK);
+	else
+		memcpy_fromio(dst, (const volatile void __iomem __force *)src,
+			      IOMEMCPY_NEON_BLOCK);
+}
+#endif
+
+/*
+ * A fixed side repeats the same IOMEMCPY_NEON_BLOCK window, for FIFOs
+ * decoding at least that much address space. Copies nothing and
+ * returns 0 where NEON is built in but not usable right now, callers
+ * then fall back to word copies.
+ */
+static int neon_copy(void *dst, const volatile void *src, size_t len,
+		     bool toio, bool dst_fixed, bool src_fixed)
+{
+	size_t chunk, n;
+
+#ifdef IOMEMCPY_HAVE_NEON
+	if (!may_use_simd())
+		return (0);
+#endif
+	for (; 0U != len; len -= chunk) {
+		chunk = min_t(size_t, len, IOMEMCPY_NEON_CHUNK);
+#ifdef IOMEMCPY_HAVE_NEON
+		kernel_neon_begin();
+#endif
+		for (n = 0U; n != chunk; n += IOMEMCPY_NEON_BLOCK) {
+			neon_block(dst, src, toio);
+			if (!dst_fixed)
+				dst = (void *)((u8 *) dst + IOMEMCPY_NEON_BLOCK);
+			if (!src_fixed)
+				src = (const volatile void *)
+					((const u8 *) src + IOMEMCPY_NEON_BLOCK);
+		}
+#ifdef IOMEMCPY_HAVE_NEON
+		kernel_neon_end();
+#endif
+	}
+	return (1);
+}
+
+int iomemcpy_neon_fromio(void *dst, const volatile void __iomem * src,
+			 size_t len)
+{
+	fail_on_inval_neon_args(dst, src, len);
+	return neon_copy(dst, (const volatile void __force *)src, len,
+			 false, false, false);
+}
+
+int iomemcpy_neon_from_fifo(void *dst, const volatile void __iomem * src,
+			    size_t len)
+{
+	fail_on_inval_neon_args(dst, src, len);
+	return neon_copy(dst, (const volatile void __force *)src, len,
+			 false, false, true);
+}
+
+int iomemcpy_neon_toio(volatile void __iomem * dst, const void *src,
+		       size_t len)
+{
+	fail_on_inval_neon_args(dst, src, len);
+	return neon_copy((void __force *)dst, src, len, true, false, false);
+}
+
+int iomemcpy_neon_to_fifo(volatile void __iomem * dst, const void *src,
+			  size_t len)
+{
+	fail_on_inval_neon_args(dst, src, len);
+	return neon_copy((void __force *)dst, src, len, true, true, false);
+}
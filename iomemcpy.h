@@ -11,4 +11,20 @@ int iomemcpy32_to_fifo(volatile void __iomem * dst, const void *src,
 		       size_t len);
 int iomemcpy64_toio(volatile void __iomem * dst, const void *src, size_t len);
 
+/*
+ * 64 bit aligned io side, len multiple of IOMEMCPY_NEON_BLOCK.
+ * The fifo variants access an IOMEMCPY_NEON_BLOCK wide window.
+ * Return 0 without copying when NEON is not usable in this context.
+ */
+#define IOMEMCPY_NEON_BLOCK	(64U)
+
+int iomemcpy_neon_fromio(void *dst, const volatile void __iomem * src,
+			 size_t len);
+int iomemcpy_neon_from_fifo(void *dst, const volatile void __iomem * src,
+			    size_t len);
+int iomemcpy_neon_toio(volatile void __iomem * dst, const void *src,
+		       size_t len);
+int iomemcpy_neon_to_fifo(volatile void __iomem * dst, const void *src,
+			  size_t len);
+
 #endif /* !defined(IOMEMCPY_H) */
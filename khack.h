@@ -192,10 +192,8 @@ dma_drv_hack_chdir(struct dma_async_tx_descriptor *tx)
 {
 	struct dma_pl330_desc *desc, *last = to_desc(tx);
 	list_for_each_entry(desc, &last->node, node) {
-		LOG_INFO("chdir: %d -> %d\n", desc->rqtype, DMA_MEM_TO_MEM);
 		desc->rqtype = DMA_MEM_TO_MEM;
 	}
-	LOG_INFO("chdir: %d -> %d\n", last->rqtype, DMA_MEM_TO_MEM);
 	last->rqtype = DMA_MEM_TO_MEM;
 }
 
@@ -217,6 +215,63 @@ dma_drv_hack_setfifo(struct dma_async_tx_descriptor *tx,
 	}
 }
 
+/*
+ * Addresses and increment mode of one request of a prepared chain.
+ * Lets a single slave_sg chain carry requests in both directions
+ * and to different bridge offsets.
+ */
+struct dma_drv_seg {
+	u32 src;
+	u32 dst;
+	unsigned src_inc:1;
+	unsigned dst_inc:1;
+	enum pl330_cachectrl scctl;
+	enum pl330_cachectrl dcctl;
+};
+
+static inline void
+_dma_drv_hack_setseg(struct dma_pl330_desc *desc,
+		     const struct dma_drv_seg *seg)
+{
+	desc->px.src_addr = seg->src;
+	desc->px.dst_addr = seg->dst;
+	desc->rqcfg.src_inc = seg->src_inc;
+	desc->rqcfg.dst_inc = seg->dst_inc;
+	desc->rqcfg.scctl = seg->scctl;
+	desc->rqcfg.dcctl = seg->dcctl;
+}
+
+/* segs[] must hold one entry per sg entry the chain was prepared from */
+static inline void
+dma_drv_hack_setsegs(struct dma_async_tx_descriptor *tx,
+		     const struct dma_drv_seg *segs)
+{
+	struct dma_pl330_desc *desc, *last = to_desc(tx);
+	list_for_each_entry(desc, &last->node, node) {
+		_dma_drv_hack_setseg(desc, segs++);
+	}
+	_dma_drv_hack_setseg(last, segs);
+}
+
+/* AxCACHE of the memory side of every request, the bridge side is left */
+static inline void
+dma_drv_hack_setcache(struct dma_async_tx_descriptor *tx,
+		      enum dma_transfer_direction dir,
+		      enum pl330_cachectrl cctl)
+{
+	struct dma_pl330_desc *desc, *last = to_desc(tx);
+	list_for_each_entry(desc, &last->node, node) {
+		if (dir == DMA_DEV_TO_MEM)
+			desc->rqcfg.dcctl = cctl;
+		else
+			desc->rqcfg.scctl = cctl;
+	}
+	if (dir == DMA_DEV_TO_MEM)
+		last->rqcfg.dcctl = cctl;
+	else
+		last->rqcfg.scctl = cctl;
+}
+
 static inline void
 dma_drv_hack_mkcyclic(struct dma_chan *chan, int cyclic)
 {
@@ -2,33 +2,182 @@
 #define __PLNG_DMA_DRV_H__
 
 #include <linux/types.h>
+#include <linux/atomic.h>
 #include <linux/mm_types.h>
 #include <linux/completion.h>
 #include <linux/platform_device.h>
 #include <linux/dmaengine.h>
 #include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include "rlsctl.h"
 
 #define IOBUF_SIZE (BUF_MAX_SIZE)
+/* DUMB_OPMODE staging, fits L1 along with the io side */
+#define DMA_PIO_CHUNK (8192U)
+#define DMA_DRV_CHAN_MAX (8U)
+/* calibration sizes 64B..1MiB */
+#define DMA_AUTO_NPTS (15U)
+/* log2 size classes of polled transfers */
+#define DMA_POLL_BUCKETS (32U)
+
+struct dma_regbuf;
+struct dma_xferobj;
+struct dma_pg_arena;
+struct dma_sim;
+struct plng_dma_device;
+
+/* CPU access to the bridge, fifo is INCR_ADDR or FIFO_ADDR */
+struct dma_pio_ops {
+	void (*read)(struct plng_dma_device *dma_dev, void *dst,
+		     loff_t br_offset, size_t len, unsigned long fifo);
+	void (*write)(struct plng_dma_device *dma_dev, const void *src,
+		      loff_t br_offset, size_t len, unsigned long fifo);
+};
+
+enum {
+	SLOT_CPU = 0,
+	SLOT_DEV,
+};
+
+struct dma_slot {
+	struct completion done;
+	dma_cookie_t cookie;
+	enum dma_transfer_direction dir;
+	size_t len;
+	int state;
+};
+
+/* Transfer stages timed for DUMB, DMA and DMAPG reads and writes */
+enum {
+	DMA_STAT_PIN = 0,	/* get_usr_buf */
+	DMA_STAT_CONFIG,	/* dmaengine_slave_config */
+	DMA_STAT_PREP,		/* dmaengine_prep_slave_sg */
+	DMA_STAT_HW,		/* submit to completion callback */
+	DMA_STAT_WAKE,		/* callback to waiter running */
+	DMA_STAT_TOTAL,
+	DMA_STAT_NSTAGES
+};
+
+#define DMA_STAT_NMODES (DMAPG_OPMODE + 1)
+#define DMA_STAT_BUCKETS (32U)
+
+/* log2 latency histogram */
+struct dma_stat_hist {
+	atomic_long_t b[DMA_STAT_BUCKETS];
+};
+
+struct dma_stat_ts;
+
+/* On stack completion of one transfer */
+struct dma_wait {
+	struct completion done;
+	u64 irq_ns;
+	struct dma_stat_ts *ts;		/* NULL if not traced */
+};
+
+/* Best of several runs for one size, 0 if not measured */
+struct dma_auto_point {
+	u32 size;
+	u64 pio_ns;
+	u64 dma_ns;
+	u64 pg_ns;
+};
 
 struct plng_dma_device {
-	void *buf;
-        dma_addr_t dma_buf;
+	void *pio_buf;		/* DUMB_OPMODE staging, DMA_PIO_CHUNK */
+	struct mutex pio_lock;
+	const struct dma_pio_ops *pio;
+	/* 64 bit bridge, NEON bursts, see dma_drv_map_bridge() */
+	bool pio_neon;
+	bool pio_neon_fifo;
 	void __iomem *base;
+	phys_addr_t base_phys;
 	dma_addr_t dma_base;
 	unsigned base_size;
-	struct dma_chan *dmach;
+	struct dma_sim *sim;		/* NULL unless bridge is simulated */
+	struct dma_chan *dmach;		/* dmachs[0], "rxtx" */
+	struct dma_chan *dmachs[DMA_DRV_CHAN_MAX];
+	unsigned nchans;
+	u32 stripes;			/* default for new files */
 
-	unsigned long dma_mode;
-	unsigned long fifo_mode;
+	/* ACP_IOBUF: bus address of physical 0 through the ACP */
+	u32 acp_base;
+	u32 acp_size;			/* 0 if there is no ACP window */
+
+	/* held from slave config to submit, see dma_chan_get() */
+	struct mutex chan_lock;
+	dma_cookie_t last_cookie;
+
+	/* queued aio kiocbs, see dma_aio_fini() */
+	spinlock_t aio_lock;
+	struct list_head aio_list;
+	wait_queue_head_t aio_wait;
+
+	/* owner of the running cyclic transfer */
+	struct plng_dma_ctx *cyclic_ctx;
+
+	/* AUTO_OPMODE thresholds in bytes, sysfs auto_pio_max/auto_pg_min */
+	u32 auto_pio_max;
+	u32 auto_pg_min;
+	struct mutex cal_lock;
+	struct dma_auto_point cal[DMA_AUTO_NPTS];
 
-	struct completion transfer_ok;
-	struct vm_area_struct *usr_vma;
+	/* read()/write() up to poll_max bytes spin, sysfs poll_* */
+	u32 poll_max;
+	bool poll_hybrid;
+	u64 poll_est_ns[DMA_POLL_BUCKETS];
+	atomic_long_t poll_waits;
+	atomic_long_t irq_waits;
+	struct dentry *dbg_dir;
+
+	/* [mode][write][stage] */
+	struct dma_stat_hist stats[DMA_STAT_NMODES][2][DMA_STAT_NSTAGES];
 
 	struct miscdevice mdev;
 	struct platform_device *pdev;
 	void (*dma_callback)(void*);
 };
 
+/* Per-open state, file->private_data */
+struct plng_dma_ctx {
+	struct plng_dma_device *dma_dev;
+	struct mutex lock;
+
+	unsigned long dma_mode;
+	unsigned long fifo_mode;
+	unsigned long last_sgnum;
+	unsigned long stripes;
+	unsigned long cyclic_prev_mode;
+
+	/* DMADRV_REGBUF, dropped on release */
+	struct mutex reg_lock;
+	wait_queue_head_t reg_wait;	/* regbuf users gone */
+	struct dma_regbuf *regbufs[DMADRV_REGBUF_MAX];
+
+	/* DMAPG bookkeeping, see get_usr_buf() */
+	struct dma_pg_arena *pg_arena;
+
+	/* IOBUF, allocated on first mmap, freed on release */
+	size_t buf_size;
+	unsigned long coherency;
+	void *buf;
+	dma_addr_t dma_buf;
+
+	struct dmadrv_ring *ring;
+	wait_queue_head_t ring_wait;
+	u32 cyclic_nperiods;
+	u32 cyclic_period_len;
+	u32 cyclic_prod;
+
+	unsigned long nslots;
+	struct dma_slot slots[DMADRV_SLOTS_MAX];
+
+	/* DMADRV_XFER_*, under lock */
+	struct dma_xferobj *xferobjs[DMADRV_XFEROBJ_MAX];
+};
+
 #endif // __PLNG_DMA_DRV_H__x
@@ -14,6 +14,8 @@ enum {
   DUMB_OPMODE = 0,
   DMA_OPMODE,
   DMAPG_OPMODE,
+  CYCLIC_OPMODE,		/* entered by DMADRV_CYCLIC_START only */
+  AUTO_OPMODE,			/* DUMB, DMA or DMAPG picked per transfer */
   INVALID_OPMODE
 };
 
@@ -23,8 +25,24 @@ enum {
   INVALID_ADDR
 };
 
+/* IOBUF cache coherency, see DMADRV_SETCOHERENCY */
+enum {
+  COHERENT_IOBUF = 0,
+  CACHED_IOBUF,
+  ACP_IOBUF,
+  INVALID_IOBUF
+};
+
+enum {
+  XFER_READ = 0,
+  XFER_WRITE,
+  INVALID_XFER
+};
+
 #define BUF_MAX_SIZE (4U*1024U*1024U)
 #define IOBUF_SIZE (BUF_MAX_SIZE)
+/* Upper bound for DMADRV_SETBUFSIZE */
+#define IOBUF_SIZE_LIMIT (512U*1024U*1024U)
 
 #define FAST_BRIDGE       (0U)
 #define SLOW_BRIDGE       (1U)
@@ -33,6 +51,23 @@ enum {
 #define OPMODE        		(3U)
 #define BRIDGE         		(5U)
 #define INCRADDR       		(7U)
+#define BATCH          		(9U)
+#define REGBUF         		(11U)
+#define UNREGBUF       		(13U)
+#define SGNUM          		(15U)
+#define CYCLIC         		(17U)
+#define CYCLICSTOP     		(19U)
+#define SLOTS          		(21U)
+#define SLOTSUBMIT     		(23U)
+#define SLOTWAIT       		(25U)
+#define BUFSIZE        		(27U)
+#define STRIPES        		(29U)
+#define COHERENCY      		(31U)
+#define SYNCCPU        		(33U)
+#define SYNCDEV        		(35U)
+#define XFERNEW        		(37U)
+#define XFERRUN        		(39U)
+#define XFERDEL        		(41U)
 
 #define _IORB(type,nr,size)	_IOC(_IOC_READ,(type),(nr),(size))
 #define _IOWB(type,nr,size)	_IOC(_IOC_WRITE,(type),(nr),(size))
@@ -43,5 +78,166 @@ enum {
 #define DMADRV_GETBRIDGE   	_IORB(DMADRV_IOC_MAGIC, BRIDGE,   0)
 #define DMADRV_SETINCRADDR  	_IOWB(DMADRV_IOC_MAGIC, INCRADDR, 0)
 #define DMADRV_GETINCRADDR   	_IORB(DMADRV_IOC_MAGIC, INCRADDR, 0)
+/* sg segments (= PL330 requests) of the last DMAPG transfer */
+#define DMADRV_GETSGNUM   	_IORB(DMADRV_IOC_MAGIC, SGNUM,    0)
+/*
+ * IOBUF size of this open file, IOBUF_SIZE by default. Page multiple
+ * up to IOBUF_SIZE_LIMIT, can only be set before the first mmap.
+ */
+#define DMADRV_SETBUFSIZE   	_IOWB(DMADRV_IOC_MAGIC, BUFSIZE,  0)
+#define DMADRV_GETBUFSIZE   	_IORB(DMADRV_IOC_MAGIC, BUFSIZE,  0)
+/*
+ * PL330 channels an INCR_ADDR DMA/DMAPG transfer of at least
+ * DMADRV_STRIPE_MIN bytes is split across. Defaults to the
+ * "plng,dma-stripes" DT property, limited by the "rxtx", "rxtx1", ...
+ * channels the node provides. 1 turns striping off.
+ */
+#define DMADRV_SETSTRIPES   	_IOWB(DMADRV_IOC_MAGIC, STRIPES,  0)
+#define DMADRV_GETSTRIPES   	_IORB(DMADRV_IOC_MAGIC, STRIPES,  0)
+#define DMADRV_STRIPE_MIN	(256U*1024U)
+/*
+ * IOBUF cache coherency of this open file, set before the first mmap.
+ * COHERENT_IOBUF: uncached memory, no maintenance (default).
+ * CACHED_IOBUF: cacheable memory, the driver cleans or invalidates
+ *   the range of each transfer it runs.
+ * ACP_IOBUF: cacheable memory the PL330 reaches through the ACP
+ *   window ("plng,acp-base" DT property), no maintenance.
+ * Cached IOBUFs are page allocator memory, so at most 4 MiB usually.
+ */
+#define DMADRV_SETCOHERENCY	_IOWB(DMADRV_IOC_MAGIC, COHERENCY, 0)
+#define DMADRV_GETCOHERENCY	_IORB(DMADRV_IOC_MAGIC, COHERENCY, 0)
+
+/*
+ * Cache maintenance of [offset, offset + len) of a CACHED_IOBUF, for
+ * transfers the driver does not sync itself (mmap'd data the CPU and
+ * a slot or cyclic capture share). dir is the transfer the range is
+ * used for: FOR_DEV before it, FOR_CPU after it. No-op for the other
+ * coherency modes.
+ */
+struct dmadrv_sync {
+	__u64 offset;
+	__u64 len;
+	__u32 dir;		/* XFER_READ: bridge -> memory */
+	__u32 flags;		/* must be 0 */
+};
+
+#define DMADRV_SYNC_FOR_CPU	_IOW(DMADRV_IOC_MAGIC, SYNCCPU, struct dmadrv_sync)
+#define DMADRV_SYNC_FOR_DEV	_IOW(DMADRV_IOC_MAGIC, SYNCDEV, struct dmadrv_sync)
+
+#define DMADRV_BATCH_MAX	(64U)
+
+/*
+ * One entry of DMADRV_BATCH. addr is either an mmap alias of IOBUF
+ * or any user address (pinned like in DMAPG_OPMODE). The bridge side
+ * follows the current INCRADDR mode.
+ */
+struct dmadrv_xfer {
+	__u32 dir;		/* XFER_READ: bridge -> memory */
+	__s32 status;		/* out: 0 or -errno */
+	__u64 br_offset;
+	__u64 addr;
+	__u64 len;
+};
+
+struct dmadrv_batch {
+	__u64 xfers;		/* struct dmadrv_xfer[count] */
+	__u32 count;		/* up to DMADRV_BATCH_MAX */
+	__u32 flags;		/* must be 0 */
+};
+
+#define DMADRV_BATCH		_IOWR(DMADRV_IOC_MAGIC, BATCH, struct dmadrv_batch)
+
+#define DMADRV_REGBUF_MAX	(16U)
+
+/*
+ * Pin and map [addr, addr + len) once. DMAPG_OPMODE transfers that
+ * fall inside a registered range skip pinning and mapping.
+ * Registration is dropped when the range gets unmapped or remapped.
+ * Handles belong to the file and are all dropped when it is closed.
+ */
+struct dmadrv_regbuf {
+	__u64 addr;
+	__u64 len;
+	__u32 handle;		/* out */
+	__u32 flags;		/* must be 0 */
+};
+
+#define DMADRV_REGBUF		_IOWR(DMADRV_IOC_MAGIC, REGBUF, struct dmadrv_regbuf)
+#define DMADRV_UNREGBUF		_IOWB(DMADRV_IOC_MAGIC, UNREGBUF, 0)
+
+/*
+ * Continuous capture into IOBUF split in nperiods (power of 2)
+ * periods. Progress is published in struct dmadrv_ring, a page
+ * mmap'able at DMADRV_RING_OFFSET, past the largest IOBUF. Period p
+ * is stored at (p & (nperiods - 1)) * period_len. Counters wrap
+ * at 2^32.
+ */
+struct dmadrv_cyclic {
+	__u64 br_offset;	/* FIFO address inside the bridge */
+	__u32 nperiods;
+	__u32 flags;		/* must be 0 */
+};
+
+struct dmadrv_ring {
+	__u32 period_len;
+	__u32 nperiods;
+	__u32 prod;		/* periods completed, written by driver */
+	__u32 cons;		/* periods consumed, written by user */
+	__u32 overruns;		/* periods lost before being consumed */
+};
+
+#define DMADRV_RING_OFFSET	(IOBUF_SIZE_LIMIT)
+
+/*
+ * The bridge window itself, for PIO without syscalls. mmap offset is
+ * one of these plus a page aligned offset into the window, the mapping
+ * must end inside it. DEVICE maps it device-nGnRE, WC write-combining.
+ */
+#define DMADRV_BRIDGE_OFFSET	(2U*IOBUF_SIZE_LIMIT)
+#define DMADRV_BRIDGE_WC_OFFSET	(3U*IOBUF_SIZE_LIMIT)
+
+#define DMADRV_CYCLIC_START	_IOW(DMADRV_IOC_MAGIC, CYCLIC, struct dmadrv_cyclic)
+#define DMADRV_CYCLIC_STOP	_IOWB(DMADRV_IOC_MAGIC, CYCLICSTOP, 0)
+
+/*
+ * DMA_OPMODE slots: IOBUF split in nslots (power of 2) equal slots,
+ * slot k at k * buffer size / nslots in the mmap. A submitted slot
+ * belongs to the device until DMADRV_SLOT_WAIT returns for it.
+ */
+#define DMADRV_SLOTS_MAX	(16U)
+
+struct dmadrv_slot {
+	__u32 slot;
+	__u32 dir;		/* XFER_READ: bridge -> slot */
+	__u64 br_offset;
+	__u64 len;		/* up to slot size */
+};
+
+#define DMADRV_SETSLOTS		_IOWB(DMADRV_IOC_MAGIC, SLOTS, 0)
+#define DMADRV_GETSLOTS		_IORB(DMADRV_IOC_MAGIC, SLOTS, 0)
+#define DMADRV_SLOT_SUBMIT	_IOW(DMADRV_IOC_MAGIC, SLOTSUBMIT, struct dmadrv_slot)
+#define DMADRV_SLOT_WAIT	_IOWB(DMADRV_IOC_MAGIC, SLOTWAIT, 0)
+
+/*
+ * Transfer between an IOBUF range and the bridge built once and run
+ * many times by handle. The bridge side follows the INCRADDR mode at
+ * creation. Where the DMA channel allows it the prepared descriptor
+ * itself is reused, otherwise only its setup is cached.
+ */
+#define DMADRV_XFEROBJ_MAX	(16U)
+
+struct dmadrv_xferobj {
+	__u32 dir;		/* XFER_READ: bridge -> IOBUF */
+	__u32 handle;		/* out */
+	__u64 br_offset;
+	__u64 offset;		/* into IOBUF */
+	__u64 len;
+	__u32 flags;		/* must be 0 */
+	__u32 pad;
+};
+
+#define DMADRV_XFER_CREATE	_IOWR(DMADRV_IOC_MAGIC, XFERNEW, struct dmadrv_xferobj)
+#define DMADRV_XFER_LAUNCH	_IOWB(DMADRV_IOC_MAGIC, XFERRUN, 0)
+#define DMADRV_XFER_DESTROY	_IOWB(DMADRV_IOC_MAGIC, XFERDEL, 0)
 
 #endif /* !defined(DMADRV_H) */
@@ -0,0 +1,311 @@
+/**
+ * @file:	dma_bench.c
+ * @version:	1.0.0
+ * @date:	17 Oct 2026
+ *
+ * Throughput/latency sweep over op modes, address modes, directions,
+ * buffer placement and transfer sizes. One CSV line per point.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "rlsctl.h"
+
+#define BENCH_MIN_SIZE	(64UL)
+
+enum {
+	PLACE_MMAP = 0,
+	PLACE_HEAP,
+	PLACE_NUM
+};
+
+static const char *mode_names[] = { "DUMB", "DMA", "DMAPG" };
+static const char *addr_names[] = { "INCR", "FIFO" };
+static const char *dir_names[] = { "READ", "WRITE" };
+static const char *place_names[] = { "mmap", "heap" };
+
+struct bench_cfg {
+	const char *dev;
+	unsigned iters;
+	size_t max_size;
+	size_t align;
+	unsigned modes;		/* bit per op mode */
+	unsigned addrs;		/* bit per INCR_ADDR/FIFO_ADDR */
+	unsigned dirs;		/* bit per XFER_READ/XFER_WRITE */
+	unsigned places;	/* bit per PLACE_* */
+};
+
+struct bench_res {
+	double mbps;
+	double p50_us;
+	double p99_us;
+	double p999_us;
+	double cpu_ns_per_byte;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t cpu_ns(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ((uint64_t)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) *
+		1000000000ULL +
+		((uint64_t)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double pct_us(const uint64_t *lat, unsigned n, double p)
+{
+	unsigned i = (unsigned)(p * (n - 1) + 0.5);
+
+	return lat[i] / 1000.0;
+}
+
+/* Returns 0 and fills res, or -errno of the first failed transfer */
+static int bench_point(int fd, void *buf, size_t size, unsigned dir,
+		       unsigned iters, uint64_t *lat, struct bench_res *res)
+{
+	uint64_t t0, t1, c0, total = 0;
+	ssize_t ret;
+	unsigned i;
+
+	/* warm up: first transfer pays page faults and pinning setup */
+	ret = dir == XFER_READ ? read(fd, buf, size) : write(fd, buf, size);
+	if (ret < 0)
+		return -errno;
+
+	c0 = cpu_ns();
+	for (i = 0; i != iters; i++) {
+		t0 = now_ns();
+		ret = dir == XFER_READ ? read(fd, buf, size) :
+			write(fd, buf, size);
+		t1 = now_ns();
+		if (ret < 0)
+			return -errno;
+		if ((size_t)ret != size)
+			return -EIO;
+		lat[i] = t1 - t0;
+		total += lat[i];
+	}
+
+	qsort(lat, iters, sizeof(*lat), cmp_u64);
+	res->mbps = (double)size * iters / (total / 1e9) / 1e6;
+	res->p50_us = pct_us(lat, iters, 0.50);
+	res->p99_us = pct_us(lat, iters, 0.99);
+	res->p999_us = pct_us(lat, iters, 0.999);
+	res->cpu_ns_per_byte = (double)(cpu_ns() - c0) / ((double)size * iters);
+	return 0;
+}
+
+static unsigned parse_set(const char *arg, const char **names, unsigned n)
+{
+	char *s = strdup(arg), *tok, *save = NULL;
+	unsigned i, set = 0;
+
+	for (tok = strtok_r(s, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i != n; i++) {
+			if (!strcasecmp(tok, names[i]))
+				break;
+		}
+		if (i == n) {
+			fprintf(stderr, "unknown value '%s'\n", tok);
+			exit(2);
+		}
+		set |= 1U << i;
+	}
+	free(s);
+	return set;
+}
+
+/* One CSV line per size, from BENCH_MIN_SIZE up to cfg->max_size */
+static void sweep(int fd, const struct bench_cfg *cfg, unsigned mode,
+		  unsigned addr, unsigned dir, unsigned place, void *buf,
+		  uint64_t *lat)
+{
+	struct bench_res res = { 0 };
+	size_t size;
+	int ret;
+
+	for (size = BENCH_MIN_SIZE; size <= cfg->max_size; size <<= 1) {
+		ret = bench_point(fd, buf, size, dir, cfg->iters, lat, &res);
+		printf("%s,%s,%s,%s,%zu,%zu,%u,", mode_names[mode],
+		       addr_names[addr], dir_names[dir], place_names[place],
+		       cfg->align, size, cfg->iters);
+		if (ret)
+			printf(",,,,,%s\n", strerror(-ret));
+		else
+			printf("%.2f,%.2f,%.2f,%.2f,%.3f,\n", res.mbps,
+			       res.p50_us, res.p99_us, res.p999_us,
+			       res.cpu_ns_per_byte);
+		fflush(stdout);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -d dev      device node (/dev/dma_miscdev)\n"
+		"  -n iters    transfers per point (1000)\n"
+		"  -s max      largest size, default the IOBUF size\n"
+		"  -a align    byte offset added to every buffer (0)\n"
+		"  -m modes    DUMB,DMA,DMAPG (all)\n"
+		"  -f addrs    INCR,FIFO (all)\n"
+		"  -D dirs     READ,WRITE (READ, writes reach the FPGA)\n"
+		"  -p places   mmap,heap (all)\n"
+		"CSV on stdout: mode,addr,dir,place,align,size,iters,mbps,"
+		"p50_us,p99_us,p999_us,cpu_ns_per_byte[,error]\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_cfg cfg = {
+		.dev = "/dev/dma_miscdev",
+		.iters = 1000,
+		.modes = 0x7,
+		.addrs = 0x3,
+		.dirs = 1U << XFER_READ,
+		.places = 0x3,
+	};
+	unsigned mode, addr, dir, place;
+	size_t bufsize;
+	void *map, *heap, *buf;
+	uint64_t *lat;
+	long val;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "d:n:s:a:m:f:D:p:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			cfg.dev = optarg;
+			break;
+		case 'n':
+			cfg.iters = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			cfg.max_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			cfg.align = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			cfg.modes = parse_set(optarg, mode_names, 3);
+			break;
+		case 'f':
+			cfg.addrs = parse_set(optarg, addr_names, 2);
+			break;
+		case 'D':
+			cfg.dirs = parse_set(optarg, dir_names, 2);
+			break;
+		case 'p':
+			cfg.places = parse_set(optarg, place_names, PLACE_NUM);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!cfg.iters)
+		usage(argv[0]);
+
+	fd = open(cfg.dev, O_RDWR);
+	if (fd < 0) {
+		perror(cfg.dev);
+		return 1;
+	}
+
+	val = ioctl(fd, DMADRV_GETBUFSIZE, 0);
+	if (val <= 0) {
+		perror("DMADRV_GETBUFSIZE");
+		return 1;
+	}
+	bufsize = val;
+	if (!cfg.max_size || cfg.max_size + cfg.align > bufsize)
+		cfg.max_size = bufsize - cfg.align;
+
+	map = mmap(NULL, bufsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	if (posix_memalign(&heap, 4096, bufsize)) {
+		fprintf(stderr, "posix_memalign failed\n");
+		return 1;
+	}
+	memset(heap, 0x5a, bufsize);
+	lat = calloc(cfg.iters, sizeof(*lat));
+	if (!lat) {
+		fprintf(stderr, "calloc failed\n");
+		return 1;
+	}
+
+	printf("mode,addr,dir,place,align,size,iters,mbps,"
+	       "p50_us,p99_us,p999_us,cpu_ns_per_byte,error\n");
+
+	for (mode = DUMB_OPMODE; mode <= DMAPG_OPMODE; mode++) {
+		if (!(cfg.modes & (1U << mode)))
+			continue;
+		if (ioctl(fd, DMADRV_SETOPMODE, mode) < 0) {
+			perror("DMADRV_SETOPMODE");
+			return 1;
+		}
+		for (addr = INCR_ADDR; addr <= FIFO_ADDR; addr++) {
+			if (!(cfg.addrs & (1U << addr)))
+				continue;
+			if (ioctl(fd, DMADRV_SETINCRADDR, addr) < 0) {
+				perror("DMADRV_SETINCRADDR");
+				return 1;
+			}
+			for (dir = XFER_READ; dir <= XFER_WRITE; dir++) {
+				if (!(cfg.dirs & (1U << dir)))
+					continue;
+				for (place = 0; place != PLACE_NUM; place++) {
+					if (!(cfg.places & (1U << place)))
+						continue;
+					/* DMA_OPMODE needs an IOBUF alias */
+					if (mode == DMA_OPMODE &&
+					    place != PLACE_MMAP)
+						continue;
+					buf = (char *)(place == PLACE_MMAP ? map :
+						       heap) + cfg.align;
+					sweep(fd, &cfg, mode, addr, dir, place,
+					      buf, lat);
+				}
+			}
+		}
+	}
+
+	free(lat);
+	free(heap);
+	munmap(map, bufsize);
+	close(fd);
+	return 0;
+}